@@ -32,7 +32,7 @@ public:
     Accumulator(T const& limit) : value_{}, limit_(limit) {}
     void valueInc(T const& value) { value_ += value; }
     void valueIs(T const& value) { value_ = value; }
-    T value() const { value_; }
+    T value() const { return value_; }
     operator bool() { return value_ > limit_; }
 
 private:
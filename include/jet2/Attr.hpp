@@ -28,6 +28,22 @@
 
 namespace jet2 {
 
+void dirtyIs(Model* model); // Marks the model as changed; see Model.cpp
+
+template <typename T, typename Enable=void>
+struct Packed; // See Functor.hpp
+
+template <typename T>
+auto attrEq(T const& a, T const& b, int) -> decltype(bool(a == b)) {
+// True if the values are equal; types without operator== never are
+    return a == b;
+}
+
+template <typename T>
+bool attrEq(T const& a, T const& b, long) {
+    return false;
+}
+
 template <typename T>
 class AttrConst {
 // A constant.  Technically, constants don't require an attr accessor like
@@ -46,22 +62,46 @@ protected:
 
 template <typename T>
 class Attr {
-// A writable attribute.  Provides a setter along with the getter.
+// A writable attribute.  Provides a setter along with the getter.  If the attr
+// is serialized by a replicated Model, then it is bound to that model, and
+// writes mark the model dirty so that it is included in the next net frame.
+// The binding costs one pointer per attr.  It belongs to the attr's storage,
+// not its value, so copying an attr copies the value only: the copy is
+// unbound, and assigning to a bound attr marks its own model dirty.
 public:
     template <typename... Arg>
     Attr(Arg... arg) : value_(arg...) {}
 
     Attr(T const& value) : value_(value) {} // Creates an attr w/ an initial val
-    T const& operator=(T const& value) { value_ = value; return value; } 
+    Attr(Attr const& other) : value_(other.value_) {}
+    Attr(Attr&& other) : value_(std::move(other.value_)) {}
+    Attr& operator=(Attr const& other) { *this = other.value_; return *this; }
+    T const& operator=(T const& value);
     T const& operator()(T const& value) { return *this = value; }
     T const& operator()() const { return value_; }
 
 private:
     T& ref() { return value_; }
     T value_;
+    Model* owner_ = nullptr;
     friend class Functor;
+    template <typename, typename> friend struct Packed;
 };
 
+template <typename T>
+T const& Attr<T>::operator=(T const& value) {
+// Assign a value to the attribute, and mark the owning model dirty if the
+// value changed, so that re-assigning the same value each tick doesn't resend
+// the model.  Reads from the network write to ref() instead, so received
+// values are not echoed back to the sender.
+    auto const changed = owner_ && !attrEq(value_, value, 0);
+    value_ = value;
+    if (changed) {
+        dirtyIs(owner_);
+    }
+    return value;
+}
+
 template <typename T>
 class AttrLive {
 // An attribute that generates events.  An Attr is like a regular C++ class
@@ -29,10 +29,10 @@ namespace jet2 {
 
 class Client : public Object {
 public:
-    ~Client() { if (conn()) { conn()->sd()->close(); } }
+    ~Client();
     Attr<Ptr<coro::Coroutine>> recv;
     Attr<Ptr<coro::Coroutine>> send;
-    Attr<Ptr<coro::Coroutine>> benchmark;
+    Attr<Ptr<coro::Coroutine>> recvUdp;
     AttrConst<Ptr<jet2::Connection>> conn;
     Attr<ClientId> id;
 };
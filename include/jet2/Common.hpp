@@ -48,7 +48,9 @@
 #include <string>
 #include <functional>
 #include <vector>
+#include <deque>
 #include <unordered_map>
+#include <typeindex>
 #include <memory>
 #include <map>
 #include <cassert>
@@ -77,11 +79,15 @@ class Functor;
 class InputDispatcher;
 class Model;
 class Object;
+class NetClock;
+class Recorder;
+class Replay;
 class Server;
 class Table;
 class Timer;
 
 typedef uint32_t TickId;
+typedef int64_t NetTime; // Microseconds, on the local monotonic clock
 
 template <typename T>
 using Ptr = std::shared_ptr<T>;
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "jet2/Common.hpp"
+
+namespace jet2 {
+
+class Compressor {
+// A fast LZ77 byte compressor in the style of LZ4.  The output is a sequence
+// of (literals, match) pairs: a token byte holds the literal count and the
+// match length in its two nibbles, followed by extra length bytes if needed,
+// the literals, and a 16-bit match offset.  Each call compresses one frame;
+// matches may refer back into the previous frame (the dictionary), which is
+// where most of the redundancy in a replication stream is.
+public:
+    static size_t const MIN_MATCH = 4;
+    static size_t const MAX_OFFSET = 65535;
+    static size_t const HASH_BITS = 14;
+
+    void compress(char const* in, size_t len, std::vector<char>& out);
+    void dictionaryIs(char const* buf, size_t len);
+    uint64_t bytesIn() const { return bytesIn_; }
+    uint64_t bytesOut() const { return bytesOut_; }
+    uint64_t nanosec() const { return nanosec_; } // Time spent compressing
+
+private:
+    std::vector<char> window_; // Dictionary followed by the current frame
+    std::vector<uint32_t> hash_; // Last stream position+1 for each hash
+    size_t dictionary_ = 0; // Length of the dictionary in window_
+    uint64_t origin_ = 0; // Stream position of window_[0]
+    uint64_t hashed_ = 0; // Stream positions before this are in hash_
+    uint64_t bytesIn_ = 0;
+    uint64_t bytesOut_ = 0;
+    uint64_t nanosec_ = 0;
+};
+
+class Decompressor {
+// Decompresses frames written by Compressor.  The decompressor must see the
+// same frames in the same order, so that its dictionary matches.
+public:
+    bool decompress(char const* in, size_t len, size_t rawLen);
+    char const* data() const { return window_.empty() ? 0 : &window_.front()+dictionary_; }
+    size_t size() const { return window_.size()-dictionary_; }
+
+private:
+    std::vector<char> window_; // Dictionary followed by the last frame
+    size_t dictionary_ = 0;
+};
+
+}
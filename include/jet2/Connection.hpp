@@ -23,16 +23,44 @@
 #pragma once
 
 #include "jet2/Common.hpp"
+#include "jet2/Accumulator.hpp"
+#include "jet2/Compress.hpp"
 #include "jet2/Object.hpp"
 #include "jet2/Functor.hpp"
 #include "jet2/Attr.hpp"
 #include "jet2/Hash.hpp"
 #include "jet2/Reader.hpp"
 #include "jet2/Model.hpp"
+#include "jet2/NetClock.hpp"
+#include "jet2/Schema.hpp"
+#include "jet2/Snapshot.hpp"
 #include "jet2/Writer.hpp"
 
 namespace jet2 {
 
+size_t const SCOPE_SWEEP_MIN = 256; // Models swept per frame, at least
+size_t const DATAGRAM_SIZE = 1200; // Max datagram payload; stays below the MTU
+typedef uint32_t SeqId;
+typedef uint32_t MessageLen; // Prefixes each message on the TCP stream, as a varint
+uint8_t const MESSAGE_FLAG_BITS = 3; // Flags are packed below the id; see beginMessage()
+typedef uint32_t FrameLen;
+size_t const MAX_FRAME_SIZE = 16*1024*1024; // Larger frames close the connection
+
+size_t const FRAME_HEADER_SIZE = 2*sizeof(TickId)+2*sizeof(NetTime)+3*sizeof(uint32_t)+sizeof(FrameLen);
+size_t const DATAGRAM_HEADER_SIZE = sizeof(SeqId)+2*sizeof(TickId);
+// Everything on the TCP stream after the handshake is sent in frames.  A
+// frame header holds the sender's tick id, the last of our tick ids whose
+// input it has simulated (see tickSimulated()), the timestamps for NetClock
+// (send time, echo, hold and tick phase), the number of messages in the
+// frame, and the length in bytes of the messages that follow.  If compression
+// was negotiated, the frame body is instead the uncompressed length
+// (FrameLen) followed by the compressed messages.
+
+typedef std::function<bool(Model const& focus, Model const& model)> Relevance;
+// Decides whether 'model' is in the area of interest of the player whose own
+// model is 'focus'.  Must not modify either model.
+
+Relevance withinRadius(float radius);
 
 class Connection : public Object {
 public:
@@ -44,8 +72,90 @@ public:
     AttrConst<Ptr<Reader<coro::Socket>>> reader;
     AttrConst<Ptr<Functor>> out;
     AttrConst<Ptr<Functor>> in;
+    AttrConst<Ptr<MemoryWriter>> messageWriter; // Message being sent
+    AttrConst<Ptr<Functor>> messageOut;
+    AttrConst<Ptr<MemoryReader>> messageReader; // Message being received
+    AttrConst<Ptr<MemoryReader>> frameReader; // Frame being received
+    AttrConst<Ptr<Functor>> messageIn;
+    AttrConst<Ptr<DeltaReadFunctor>> inDelta;
     AttrConst<State> state = IDLE;
-    Hash<ModelId, Ptr<Model>> model;
+    Attr<bool> delta = true; // Send field-level deltas against the baseline
+    Hash<ModelId, Ptr<Model>> model; // Models constructed on the peer
+    Hash<ModelId, ModelId> localId; // Our model for each of the peer's ids, bound by CONSTRUCT
+    Attr<bool> spawn = false; // Create the models the peer constructs that we lack; see modelTypeIs()
+
+    // Schemas of the peer's model types, from the handshake, or described
+    // in-band by SCHEMA messages.  A type that the peer encodes differently,
+    // or hasn't described, is never sent as a delta; the peer's messages for
+    // it are decoded by field, or refused if it wasn't described; see
+    // Schema.hpp.  Each type is described to the peer once: before it is
+    // first sent, or in reply to the peer's first message for it, so that the
+    // peer learns whether it can send deltas.
+    Attr<bool> schemas = false; // Schemas were exchanged in the handshake
+    Hash<std::string, Ptr<Schema const>> peerSchema; // By type name
+    std::unordered_map<std::type_index, Ptr<Schema const>> peerSchemaByType; // Null if it matches ours
+    Hash<std::string, bool> schemaOut; // Types described to the peer
+    std::vector<Ptr<Schema const>> schemaReply; // To describe in the next frame
+
+    Attr<size_t> frameOffset = size_t(0); // Offset of the frame header being sent
+    Attr<uint64_t> frameStart = uint64_t(0); // Writer bytes() after the header
+    Attr<uint32_t> frameMessages = uint32_t(0); // Messages in the frame so far
+    Attr<TickId> tickIn = TickId(0); // Tick id of the last frame received
+    Attr<TickId> tickInBefore = TickId(0); // tickIn when the current local tick began
+    Attr<TickId> tickInAt = TickId(0); // Local tick when tickIn last changed
+    AttrConst<Ptr<NetClock>> clock; // RTT, jitter and offset to the peer
+    Attr<Ptr<Recorder>> recorder; // If set before the first frame, every frame is logged
+    Attr<uint64_t> frames = uint64_t(0); // Frames sent and received
+    std::vector<Ptr<Model>> received; // Models updated by the current frame
+
+    // Frame compression, negotiated in the handshake.  Each side primes its
+    // dictionary with the previous frame body.
+    Attr<bool> compress = false;
+    Compressor compressor;
+    Decompressor decompressor;
+    std::vector<char> frameRaw; // Frame body before compression
+    std::vector<char> frameCompressed;
+    Hash<ModelId, Ptr<Snapshot const>> baseline; // Last state sent for each model
+    Attr<Ptr<DirtySet>> dirty; // Models changed since the last frame
+
+    // Bandwidth budget.  If nonzero, each frame sends pending models in order
+    // of accumulated priority until 'budget' bytes are written; the rest stay
+    // dirty and gain priority each frame until they are sent.
+    Attr<size_t> budget = size_t(0);
+    std::vector<Accumulator<float>> priority; // Indexed by modelIndex()
+    std::vector<ModelId> pending; // Models to send in the current frame
+
+    // Backpressure.  If nonzero, frames are skipped while more than
+    // 'maxUnsent' bytes wait in the socket's send queue, not yet sent (see
+    // unsent()); changed models stay dirty, so a slow peer gets only the
+    // latest state once it catches up.  Where the platform also counts unacked
+    // bytes, 'maxUnsent' must exceed the bandwidth-delay product of the link.
+    // Messages sent while the connection is busy wait in 'outbox', which
+    // keeps one entry per model.
+    Attr<size_t> maxUnsent = size_t(0);
+    Attr<uint64_t> framesSkipped = uint64_t(0);
+    std::vector<Ptr<Model>> outbox;
+
+    // Area of interest.  If both are set, CHANGED models are sent only while
+    // 'relevance' accepts them for 'focus'; models that leave the area are
+    // destroyed on the peer, and constructed again when they re-enter.  A
+    // model that doesn't change is found by a sweep that covers the table
+    // once every 'scopeFrames' frames; see scopeSweep().
+    Attr<Ptr<Model>> focus;
+    Attr<Relevance> relevance;
+    Attr<uint32_t> scopeFrames = uint32_t(8);
+    Attr<size_t> scopeCursor = size_t(0); // Last slot swept
+
+    // Optional unreliable channel.  If set, SYNC updates for CHANGED models
+    // are sent in sequenced datagrams, and the receiver keeps only the
+    // latest update for each model.  Everything else stays on the TCP socket.
+    Attr<Ptr<coro::Socket>> udp;
+    Attr<SeqId> udpSeq = SeqId(1); // Sequence number of the current frame
+    std::vector<char> udpOut; // Datagram being built
+    std::vector<SeqId> udpSeqIn; // Seq of the last update applied, by modelIndex()
+    std::vector<SeqId> udpSent; // Seq of the last unreliable send, by modelIndex()
+    std::vector<ModelId> udpUnsettled; // Models sent unreliably last frame
+    Attr<uint64_t> udpBytes = uint64_t(0); // Total datagram bytes sent
     coro::Event event;
 };
 
@@ -27,6 +27,11 @@
 
 namespace jet2 {
 
+size_t const MAX_STRING_SIZE = 1024*1024; // Longer strings close the connection
+
+// Declares the serialized fields of a class.  Runs of consecutive fixed-size
+// fields (scalars, vectors, and quaternions, or attrs of those types) are
+// packed at compile time; see Functor::vals().
 #define SERIALIZED(...) \
     void visit(Ptr<jet2::Functor> out) { \
         out->vals(__VA_ARGS__);\
@@ -37,6 +42,194 @@ namespace jet2 {
         out->vals(__VA_ARGS__);\
     }
 
+template <typename T, typename C>
+class Encoded {
+// Serializes an attr through a codec, instead of writing its raw bytes.  The
+// codec must provide size(), encode(T const&, char*), and decode(char const*,
+// T&), and its encoding must fit in 'capacity' bytes.  See Quantize.hpp.
+public:
+    static size_t const capacity = 16;
+    Encoded(Attr<T>& attr, C const& codec) : attr(attr), codec(codec) {}
+    Attr<T>& attr;
+    C const codec;
+};
+
+size_t const VARINT_MAX = 10; // Longest encoding of a 64-bit varint
+
+inline uint64_t zigzag(int64_t in) {
+// Maps signed values to unsigned ones so that values near zero stay small:
+// 0, -1, 1, -2, ... become 0, 1, 2, 3, ...
+    return (uint64_t(in) << 1) ^ uint64_t(in >> 63);
+}
+
+inline int64_t unzigzag(uint64_t in) {
+    return int64_t(in >> 1) ^ -int64_t(in & 1);
+}
+
+inline size_t varintSize(uint64_t in) {
+// Returns the number of bytes varintEncode() writes for 'in'
+    auto len = size_t(1);
+    while (in >= 0x80) {
+        in >>= 7;
+        ++len;
+    }
+    return len;
+}
+
+inline size_t varintEncode(uint64_t in, char* out) {
+// Writes 'in' seven bits at a time, least significant group first; the high
+// bit of each byte is set if another byte follows.  Returns the length.
+    auto len = size_t(0);
+    while (in >= 0x80) {
+        out[len++] = char(uint8_t(in) | 0x80);
+        in >>= 7;
+    }
+    out[len++] = char(uint8_t(in));
+    return len;
+}
+
+inline size_t varintDecode(char const* in, size_t len, uint64_t& out) {
+// Reads a varint from at most 'len' bytes.  Returns the number of bytes read,
+// or zero if the varint is truncated or too long.
+    out = 0;
+    for (size_t i = 0; i < len && i < VARINT_MAX; ++i) {
+        auto const byte = uint8_t(in[i]);
+        out |= uint64_t(byte & 0x7f) << (7*i);
+        if (!(byte & 0x80)) {
+            return i+1;
+        }
+    }
+    out = 0;
+    return 0;
+}
+
+template <typename T>
+class Varint {
+// Serializes an integer attr as a varint, so that small values take fewer
+// bytes; signed values are zigzag-encoded first.  See varint().
+public:
+    static_assert(std::is_integral<T>::value, "varint attrs must be integers");
+    Varint(Attr<T>& attr) : attr(attr) {}
+    Attr<T>& attr;
+};
+
+template <typename T>
+Varint<T> varint(Attr<T>& attr) {
+// Serialize an integer attr compactly, e.g.: SERIALIZED(varint(health))
+    return Varint<T>(attr);
+}
+
+template <size_t Size, size_t Fields>
+class PackedRun {
+// A buffer holding a run of consecutive fixed-size fields.  The size of the
+// run and the number of fields in it are computed at compile time from the
+// field types, so the buffer lives on the stack.
+public:
+    PackedRun() : len(0), fields(0), changed(false) {}
+    void append(void const* buf, size_t n) {
+        memcpy(data+len, buf, n);
+        len += n;
+        end[fields++] = uint32_t(len);
+    }
+
+    char data[Size];
+    uint32_t end[Fields]; // End offset of each field
+    size_t len;
+    size_t fields;
+    bool changed; // Set if the functor changed the bytes (i.e., on read)
+};
+
+template <typename T, typename Enable>
+struct Packed {
+// Describes how a field of type T is packed into a PackedRun.  Types without a
+// fixed-size encoding (strings, nested objects) are not packed; they are
+// serialized through the virtual Functor::val() interface instead.
+    static bool const value = false;
+    static size_t const size = 0;
+    static size_t const fields = 0;
+};
+
+template <typename T>
+struct Packed<T, typename std::enable_if<std::is_scalar<T>::value>::type> {
+    static bool const value = true;
+    static size_t const size = sizeof(T);
+    static size_t const fields = 1;
+
+    template <typename Run>
+    static void pack(Run& run, T const& in) { run.append(&in, sizeof(in)); }
+    static void unpack(char const*& buf, T& out) {
+        memcpy(&out, buf, sizeof(out));
+        buf += sizeof(out);
+    }
+};
+
+template <typename T>
+struct Packed<Attr<T>, typename std::enable_if<Packed<T>::value>::type> {
+    static bool const value = true;
+    static size_t const size = Packed<T>::size;
+    static size_t const fields = Packed<T>::fields;
+
+    template <typename Run>
+    static void pack(Run& run, Attr<T> const& in) { Packed<T>::pack(run, in()); }
+    static void unpack(char const*& buf, Attr<T>& out) { Packed<T>::unpack(buf, out.ref()); }
+};
+
+template <>
+struct Packed<sfr::Vector> {
+    typedef decltype(sfr::Vector::x) Scalar;
+    static bool const value = true;
+    static size_t const size = 3*sizeof(Scalar);
+    static size_t const fields = 3;
+
+    template <typename Run>
+    static void pack(Run& run, sfr::Vector const& in) {
+        run.append(&in.x, sizeof(Scalar));
+        run.append(&in.y, sizeof(Scalar));
+        run.append(&in.z, sizeof(Scalar));
+    }
+    static void unpack(char const*& buf, sfr::Vector& out) {
+        Packed<Scalar>::unpack(buf, out.x);
+        Packed<Scalar>::unpack(buf, out.y);
+        Packed<Scalar>::unpack(buf, out.z);
+    }
+};
+
+template <>
+struct Packed<sfr::Quaternion> {
+    typedef decltype(sfr::Quaternion::x) Scalar;
+    static bool const value = true;
+    static size_t const size = 4*sizeof(Scalar);
+    static size_t const fields = 4;
+
+    template <typename Run>
+    static void pack(Run& run, sfr::Quaternion const& in) {
+        run.append(&in.x, sizeof(Scalar));
+        run.append(&in.y, sizeof(Scalar));
+        run.append(&in.z, sizeof(Scalar));
+        run.append(&in.w, sizeof(Scalar));
+    }
+    static void unpack(char const*& buf, sfr::Quaternion& out) {
+        Packed<Scalar>::unpack(buf, out.x);
+        Packed<Scalar>::unpack(buf, out.y);
+        Packed<Scalar>::unpack(buf, out.z);
+        Packed<Scalar>::unpack(buf, out.w);
+    }
+};
+
+template <typename ...V>
+struct PackedRunSize {
+// Total size and field count of the leading run of packed types in V
+    static size_t const size = 0;
+    static size_t const fields = 0;
+};
+
+template <typename V, typename ...Arg>
+struct PackedRunSize<V, Arg...> {
+    static bool const packed = Packed<V>::value;
+    static size_t const size = packed ? Packed<V>::size+PackedRunSize<Arg...>::size : 0;
+    static size_t const fields = packed ? Packed<V>::fields+PackedRunSize<Arg...>::fields : 0;
+};
+
 class Functor : public std::enable_shared_from_this<Functor> {
 public:
     virtual ~Functor() {}
@@ -56,16 +249,24 @@ public:
     template <typename V>
     void
     val(Attr<V>& in) {
+        if (owner_) {
+            in.owner_ = owner_;
+        }
         val(in.ref());
     }
 
-    void
+    virtual void
     val(std::string& in) {
-        auto len = in.size();
-        val(len); 
-        in.resize(len);
-        val((char*)in.c_str(), len);
-        in.resize(len);
+        // The length comes from the peer, so it's bounded before anything is
+        // allocated for it
+        auto len = uint64_t(in.size());
+        valVarint(len); 
+        if (len > MAX_STRING_SIZE) {
+            throw coro::SocketCloseException();
+        }
+        in.resize(size_t(len));
+        val((char*)in.c_str(), size_t(len));
+        in.resize(size_t(len));
     }
 
     template <typename V>
@@ -74,17 +275,156 @@ public:
         visit(shared_from_this(), in);
     }
 
-    template <typename V, typename ...Arg>
+    template <typename V, typename C>
+    void
+    val(Encoded<V,C>& in) {
+        // Encode the value with a codec.  The value is decoded only if the
+        // functor changed the encoded bytes (i.e., on read), so that the
+        // sender's value isn't rounded by the codec.
+        char buf[Encoded<V,C>::capacity];
+        char old[Encoded<V,C>::capacity];
+        auto const len = in.codec.size();
+        assert(len <= sizeof(buf));
+        bind(in.attr);
+        in.codec.encode(in.attr(), buf);
+        memcpy(old, buf, len);
+        val(buf, len);
+        if (memcmp(old, buf, len)) {
+            in.codec.decode(buf, in.attr.ref());
+        }
+    }
+
+    template <typename V>
     void
-    vals(V& head, Arg&...arg) {
+    val(Varint<V>& in) {
+        // Like Encoded, the attr is only assigned if the functor changed the
+        // value (i.e., on read).
+        bind(in.attr);
+        auto value = in.attr();
+        valVarint(value);
+        if (value != in.attr()) {
+            in.attr.ref() = value;
+        }
+    }
+
+    template <typename V>
+    typename std::enable_if<std::is_signed<V>::value>::type
+    valVarint(V& in) {
+        auto value = zigzag(in);
+        valVarint(value);
+        if (V(unzigzag(value)) != in) {
+            in = V(unzigzag(value));
+        }
+    }
+
+    template <typename V>
+    typename std::enable_if<std::is_unsigned<V>::value && !std::is_same<V,uint64_t>::value>::type
+    valVarint(V& in) {
+        auto value = uint64_t(in);
+        valVarint(value);
+        if (V(value) != in) {
+            in = V(value);
+        }
+    }
+
+    virtual void valVarint(uint64_t& in) {
+    // Read or write an unsigned varint.  By default, the bytes go through
+    // val() one at a time, until one without the continuation bit: on write
+    // the functor leaves the encoded bytes as they are, and on read it
+    // replaces them with the bytes received.
+        char buf[VARINT_MAX];
+        varintEncode(in, buf);
+        for (size_t i = 0; i < VARINT_MAX; ++i) {
+            val(buf+i, 1);
+            if (!(buf[i] & 0x80)) {
+                varintDecode(buf, i+1, in);
+                return;
+            }
+        }
+        in = 0; // Malformed
+    }
+
+    template <typename V, typename ...Arg>
+    typename std::enable_if<!Packed<typename std::decay<V>::type>::value>::type
+    vals(V&& head, Arg&&...arg) {
         val(head);
-        vals(arg...);
+        vals(std::forward<Arg>(arg)...);
+    }
+
+    template <typename V, typename ...Arg>
+    typename std::enable_if<Packed<typename std::decay<V>::type>::value>::type
+    vals(V&& head, Arg&&...arg) {
+        // Pack a run of fixed-size fields into one buffer, so that the whole
+        // run costs one virtual call and one copy into the stream.
+        typedef PackedRunSize<typename std::decay<V>::type, typename std::decay<Arg>::type...> Size;
+        PackedRun<Size::size, Size::fields> run;
+        pack(run, head, std::forward<Arg>(arg)...);
     }
     
     void vals() {}
 
-protected:
     virtual void val(char* buf, size_t len)=0;
+    virtual void valPacked(char* buf, size_t len, uint32_t const* end, size_t fields) {
+    // Read or write a run of packed fields; 'end' holds the end offset of each
+    // field in the run.  By default, the run is treated as a single value.
+        val(buf, len);
+    }
+
+protected:
+    Model* owner_ = nullptr; // If set, attrs visited are bound to this model
+
+private:
+    template <typename Run, typename V, typename ...Arg>
+    typename std::enable_if<Packed<typename std::decay<V>::type>::value>::type
+    pack(Run& run, V&& head, Arg&&...arg) {
+        // Pack the fields into the run, then send the run to the functor at
+        // the end of the run.  Unpack the fields while unwinding, so that the
+        // values read by the functor (if any) are stored.  If the functor only
+        // read the run (e.g., a Snapshot), the fields aren't written at all.
+        typedef Packed<typename std::decay<V>::type> P;
+        bind(head);
+        auto const offset = run.len;
+        P::pack(run, head);
+        pack(run, std::forward<Arg>(arg)...);
+        if (run.changed) {
+            auto buf = (char const*)run.data+offset;
+            P::unpack(buf, head);
+        }
+    }
+
+    template <typename Run, typename V, typename ...Arg>
+    typename std::enable_if<!Packed<typename std::decay<V>::type>::value>::type
+    pack(Run& run, V&& head, Arg&&...arg) {
+        pack(run);
+        vals(std::forward<V>(head), std::forward<Arg>(arg)...);
+    }
+
+    template <typename Run>
+    void pack(Run& run) {
+        char old[sizeof(run.data)];
+        memcpy(old, run.data, run.len);
+        valPacked(run.data, run.len, run.end, run.fields);
+        run.changed = memcmp(old, run.data, run.len) != 0;
+    }
+
+    template <typename V>
+    void bind(Attr<V>& in) {
+        if (owner_) {
+            in.owner_ = owner_;
+        }
+    }
+
+    template <typename V>
+    void bind(V& in) {}
+};
+
+class BindFunctor : public Functor {
+// Binds each attr serialized by a model to that model, so that writes to the
+// attr mark the model dirty.  No data is read or written.
+public:
+    BindFunctor(Model* owner) { owner_ = owner; }
+    virtual void val(char* buf, size_t len) {}
+    virtual void valVarint(uint64_t& in) {}
 };
 
 
@@ -98,6 +438,10 @@ private:
     virtual void val(char* buf, size_t len) {
         fd_->write(buf, len);
     }
+    virtual void valVarint(uint64_t& in) {
+        char buf[VARINT_MAX];
+        fd_->write(buf, varintEncode(in, buf));
+    }
     Ptr<T> fd_;
 };
 
@@ -49,6 +49,7 @@ class Hash : public HashConst<K,V> {
 public:
     V const operator()(K const& key) const;
     V const& operator()(K const& key, V const& value) { this->value_[key] = value; return value; }
+    void erase(K const& key) { this->value_.erase(key); }
     void clear() { this->value_.clear(); }
 };
 
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "jet2/Common.hpp"
+
+namespace jet2 {
+
+class Interpolator {
+// A ring of the states received for a remote model, keyed by the server tick
+// of the frame that carried each state.  Remote models are rendered at a
+// server tick slightly in the past (see renderTick()), by interpolating
+// between the two states around that tick, so that they move smoothly even
+// though updates arrive only every netTimestep.
+public:
+    static size_t const CAPACITY = 32;
+
+    void sampleIs(TickId tick, sfr::Vector const& position, sfr::Quaternion const& rotation);
+    bool sample(double tick, sfr::Vector& position, sfr::Quaternion& rotation) const;
+    size_t samples() const { return count_; }
+
+private:
+    struct Sample {
+        TickId tick;
+        sfr::Vector position;
+        sfr::Quaternion rotation;
+    };
+    Sample const& at(size_t index) const { return sample_[(first_+index) % CAPACITY]; }
+
+    Sample sample_[CAPACITY];
+    size_t first_ = 0; // Oldest sample
+    size_t count_ = 0;
+};
+
+double renderTick(); // The server tick that remote models are rendered at
+
+}
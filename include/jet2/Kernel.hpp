@@ -68,21 +68,28 @@ extern Ptr<coro::Event> const renderEvent;
 extern std::vector<sf::Event> inputQueue; // FIXME
 extern coro::Time const timestep;
 extern coro::Time const netTimestep;
-extern coro::Time netDelta; // Approximate net flight time // FIXME 
 extern TickId tickId; // Tick ID (since start)
-extern TickId netTickId;
+extern NetTime tickTime; // When tickId last advanced
+extern Ptr<NetClock> serverClock; // Set by client(); maps local time to server ticks
+extern coro::Time interpDelay; // How far in the past remote models are drawn
 
 // Networking
-Ptr<Server> server(Ptr<Table> db, size_t players);
-Ptr<Client> client(Ptr<Table> db, ClientId id);
+Ptr<Server> server(Ptr<Table> db, size_t players, size_t workers=0, uint16_t port=SERVER_PORT, std::string const& host="0.0.0.0");
+Ptr<Client> client(Ptr<Table> db, ClientId id, bool udp=false, bool compress=false, std::string const& host="127.0.0.1", uint16_t port=SERVER_PORT);
 
 // Private
+Ptr<ModelTable> modelTable(Ptr<Table> db);
 void sendMessage(Ptr<Connection> conn, Ptr<Model> model);
 void sendFrame(Ptr<Connection> conn, Ptr<Table> db);
 void send(Ptr<Connection> conn, Ptr<Table> db);
 void send(Ptr<Connection> conn);
-void recvMessage(Ptr<Connection> conn, Ptr<Table> db);
+void recvFrame(Ptr<Connection> conn, Ptr<Table> db);
 void recv(Ptr<Connection> conn, Ptr<Table> db);
 void recv(Ptr<Connection> conn);
+void recvDatagram(Ptr<Connection> conn, Ptr<Table> db);
+void replay(Ptr<Replay> log, Ptr<Connection> conn, Ptr<Table> db, bool realtime=false);
+Ptr<coro::Socket> datagramSocket(uint16_t port, std::string const& addr="127.0.0.1");
+void sendSchemas(Ptr<Connection> conn, Ptr<Table> db);
+void recvSchemas(Ptr<Connection> conn);
 
 }
@@ -27,31 +27,133 @@
 
 namespace jet2 {
 
-typedef uint16_t ModelId;
+typedef uint32_t ModelId;
+// A model id holds the model's slot in its ModelTable in the low bits, and the
+// slot's generation in the high bits.  When a model is deleted, its slot is
+// reused with the next generation, so a stale id (e.g., in a late datagram)
+// doesn't resolve to the model that replaced it.  Ids for slots that were
+// never reused are equal to the slot index.
+uint32_t const MODEL_INDEX_BITS = 24;
+uint32_t const MODEL_GENERATIONS = 1 << (32-MODEL_INDEX_BITS);
+
+inline uint32_t modelIndex(ModelId id) { return id & ((1 << MODEL_INDEX_BITS)-1); }
+inline uint32_t modelGeneration(ModelId id) { return id >> MODEL_INDEX_BITS; }
+inline ModelId modelId(uint32_t index, uint32_t generation) {
+    return ModelId(generation % MODEL_GENERATIONS) << MODEL_INDEX_BITS | index;
+}
+
+class Snapshot;
+class Interpolator;
+class WorkerPool;
+class Table;
+
+class DirtySet {
+// The set of models that changed since the set was last drained.  Each
+// connection keeps one for the ModelTable it replicates, so that sending a
+// frame only visits the models that changed.
+public:
+    void modelIs(ModelId id);
+    void modelDel(ModelId id);
+    std::vector<ModelId> const& drain();
+    std::vector<ModelId> drainDeleted();
+
+private:
+    std::vector<ModelId> model_;
+    std::vector<ModelId> drained_;
+    std::vector<ModelId> queued_; // Id queued for each slot, or 0
+    std::vector<ModelId> deleted_; // Models deleted, in order
+};
+
 class ModelTable : public Object {
+// Registry of the replicated models in a Table, indexed by ModelId.  Models
+// are stored densely in a vector, so that lookup by id is an array index.
+// The Table keeps the registry up to date as models are created or deleted.
+// Slots freed by deleted models are reused, most recently freed first, so
+// the registry only grows with the number of live models.  Ids are local to
+// each side: the peer binds each of our ids to its own model at the same
+// path, which CONSTRUCT carries, so a reused slot (with its new generation)
+// is bound afresh, and the two tables never have to agree.
 public:
-    Hash<ModelId, Ptr<Model>> model;
-    Attr<ModelId> nextId = ModelId(0);
+    ~ModelTable();
+    Ptr<Model> model(ModelId id) const; // Null if the id is stale
+    Ptr<Model> modelAt(size_t index) const { return index < model_.size() ? model_[index] : 0; }
+    size_t size() const { return model_.size(); } // One past the highest slot
+    size_t models() const { return live_; } // Number of models registered
+    void modelIs(Ptr<Model> model, Table* table=nullptr, std::string const& name=std::string());
+    void modelDel(ModelId id);
+    void objectDel(ModelId id);
+    std::string path(ModelId id) const; // Path relative to root(), or empty
+    Table* root() const { return root_; } // Table being replicated, if set
+    void rootIs(Table* root) { root_ = root; }
+
+    void dirtyIs(Model* model);
+    void dirtySetIs(Ptr<DirtySet> set);
+    Ptr<Snapshot const> snapshot(Model* model);
+    void snapshotIs(std::vector<ModelId> const& ids, WorkerPool& pool);
+
+private:
+    struct Owner {
+        Table* table; // Table that holds the model, if any
+        std::string name;
+    };
+
+    std::vector<Ptr<Model>> model_; // Indexed by slot; slot 0 is unused
+    std::vector<Ptr<Snapshot const>> snapshot_; // Indexed by slot
+    std::vector<uint32_t> generation_; // Current generation of each slot
+    std::vector<Owner> owner_; // Indexed by slot
+    std::vector<uint32_t> free_; // Slots to reuse, most recently freed last
+    std::vector<WeakPtr<DirtySet>> dirtySet_;
+    Table* root_ = nullptr; // Holds the registry, so it outlives it
+    size_t live_ = 0;
 };
 
 class Model : public Object {
 public:
-    enum SyncMode { ALWAYS, ONCE, DISABLED };
-    enum SyncFlags { CONSTRUCT, SYNC };
+    enum SyncMode { CHANGED, ONCE, DISABLED };
+    // CHANGED models are sent in each frame after they change, not in every
+    // frame.  A change is a write of a new value to one of the model's
+    // serialized Attrs; writing the value it already has isn't a change.  A
+    // SERIALIZED field that isn't an Attr (or an Attr written through a
+    // nested object) isn't tracked, so code that changes one must call
+    // dirtyIs() itself.  ONCE models are sent with the next frame, and then
+    // disabled.
+    enum SyncFlags { CONSTRUCT, SYNC, DELTA, SETTLE, DESTROY, REMOVE, SCHEMA };
+    // CONSTRUCT carries the model's path and type, and binds the sender's id
+    // for it to the receiver's model at that path, which the receiver may
+    // spawn if it has none; see Connection::spawn.  SETTLE is a reliable, sequenced full
+    // update for a model that was previously sent over the unreliable channel;
+    // see sendFrame().  DESTROY means the model left the receiver's area of
+    // interest; it is sent again with CONSTRUCT if it re-enters.  REMOVE means
+    // the model was deleted by the sender, and the receiver deletes its copy
+    // too; it's ignored unless the receiver's copy is INPUT.  SCHEMA describes
+    // a model type that the handshake didn't; it has no model, and is sent
+    // with id 0.
     enum NetMode { OUTPUT, INPUT };
 
     Attr<ModelId> id = ModelId(0);
     Attr<sfr::Vector> position; // FIXME: Move to subclass
     Attr<sfr::Quaternion> rotation;  
-    Attr<SyncMode> syncMode = ALWAYS; 
+    Attr<SyncMode> syncMode = CHANGED; 
     Attr<NetMode> netMode = OUTPUT;
     Attr<TickId> tickId = 0;
+    Attr<TickId> tickAck = 0; // Last of our ticks whose input the peer had simulated for this state
+    Attr<bool> predicted = false; // Simulated locally ahead of the peer; see Predictor
+    Attr<bool> inScope = true; // Cleared by DESTROY, set again by CONSTRUCT
+    Attr<float> priority = 1.f; // Relative importance when bandwidth is limited
+    Attr<Ptr<Interpolator>> history; // States received from the peer, by server tick
+    Attr<Ptr<Snapshot const>> authority; // Last state received while predicted; DELTAs apply to it
 
     void wait() { event_.wait(); }
     void notifyAll() { event_.notifyAll(); }
+    ModelTable* table() const { return table_; }
+    void tableIs(ModelTable* table);
+    void dirtyIs() { if (table_) { table_->dirtyIs(this); } }
+    Ptr<Snapshot const> snapshot();
 
 private:
     coro::Event event_; // FIXME: Move to subclass?
+    ModelTable* table_ = nullptr;
+    friend class ModelTable;
 };
 
 }
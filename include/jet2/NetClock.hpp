@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "jet2/Common.hpp"
+
+namespace jet2 {
+
+class NetClock {
+// Estimates the round-trip time, jitter and clock offset to a peer from the
+// timestamps carried in every frame header, in the manner of NTP.  Each frame
+// carries the sender's send time, the send time of the last frame it received
+// from us (the echo), and how long it held that frame before replying.  Thus,
+// every frame received after the first yields an RTT sample that excludes
+// the peer's send interval.  The sender's tick and tick phase also give the
+// peer's fractional tick at the send time, so that local time can be mapped
+// to the peer's ticks.
+public:
+    static NetTime const INTERVAL = 1000000; // Send at least one frame this often
+
+    NetClock();
+    static NetTime now();
+
+    void sendIs(NetTime& sent, NetTime& echo, uint32_t& hold, uint32_t& phase, NetTime time=now());
+    void recvIs(TickId tick, NetTime sent, NetTime echo, uint32_t hold, uint32_t phase, NetTime time=now());
+    bool due(NetTime time=now()) const { return time-lastSent_ >= INTERVAL; }
+
+    size_t samples() const { return samples_; } // RTT samples so far
+    double rtt() const { return rtt_; } // Smoothed RTT, in microseconds
+    double jitter() const { return jitter_; } // Mean RTT deviation, in microseconds
+    double offset() const { return offset_; } // Peer clock minus local clock, in microseconds
+    double peerTick(NetTime time=now()) const; // Peer's tick at local time 'time'
+
+private:
+    NetTime lastSent_; // When we last sent a frame
+    NetTime peerSent_ = 0; // Send time of the last frame received, on the peer's clock
+    NetTime peerRecv_ = 0; // When that frame was received, on our clock
+    size_t samples_ = 0;
+    double rtt_ = 0;
+    double jitter_ = 0;
+    double offset_ = 0;
+    double tickBase_ = 0; // Peer tick at local time 0
+};
+
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "jet2/Common.hpp"
+#include "jet2/Object.hpp"
+#include "jet2/Attr.hpp"
+#include <random>
+
+namespace jet2 {
+
+class NetCondition {
+// Conditions on a simulated link, applied in both directions.  Stream links
+// (TCP) can't lose or reorder data, so a lost packet is instead delayed by a
+// retransmission timeout, and data is always delivered in order.  A link only
+// buffers about one bandwidth-delay product; beyond that, a stream sender is
+// blocked and datagrams are dropped.
+public:
+    coro::Time latency = coro::Time::millisec(0); // One way
+    coro::Time jitter = coro::Time::millisec(0); // Latency varies by up to this much either way
+    double bandwidth = 0; // Bytes per second each way; zero for unlimited
+    double loss = 0; // Fraction of packets lost
+    double reorder = 0; // Fraction of datagrams held back behind later ones
+};
+
+class NetStep {
+// A change of conditions at a given time after the profile starts
+public:
+    coro::Time at;
+    NetCondition condition;
+};
+
+typedef std::vector<NetStep> NetProfile;
+
+class NetPipe;
+
+class NetSim : public Object {
+// Simulates a network link between two local endpoints, so that replication
+// can be tested under realistic conditions over loopback.  A stream sim is a
+// TCP proxy: clients connect to its port instead of the server's, and
+// Connection, Writer and Reader work unchanged.  A datagram sim relays UDP
+// between two pairs of ports.  See streamSim() and datagramSim().
+public:
+    Attr<NetCondition> condition;
+    Attr<uint32_t> seed = uint32_t(1); // Seed for loss, jitter and reordering
+    Attr<uint64_t> packets = uint64_t(0); // Packets forwarded
+    Attr<uint64_t> dropped = uint64_t(0); // Datagrams lost
+    Attr<uint64_t> bytes = uint64_t(0); // Bytes forwarded
+    Attr<Ptr<coro::Socket>> listener;
+    Attr<Ptr<coro::Coroutine>> accept;
+    Attr<Ptr<coro::Coroutine>> script;
+
+    ~NetSim();
+    void profileIs(NetProfile const& profile); // Run a scripted profile from now
+    void pipeIs(Ptr<coro::Socket> in, Ptr<coro::Socket> out, bool stream);
+    NetTime deliver(NetPipe& pipe, size_t len);
+    size_t budget(NetPipe const& pipe);
+
+private:
+
+    std::vector<Ptr<NetPipe>> pipe_;
+    std::mt19937 random_;
+    bool seeded_ = false;
+};
+
+Ptr<NetSim> streamSim(uint16_t port, uint16_t target);
+Ptr<NetSim> datagramSim(uint16_t portA, uint16_t peerA, uint16_t portB, uint16_t peerB);
+
+}
@@ -30,34 +30,40 @@ namespace jet2 {
 
 enum NetworkMode { NONE, CLIENT, SERVER };
 
-typedef uint8_t ClientId;
+typedef uint16_t ClientId;
 typedef uint8_t MagicId;
 typedef uint8_t NetVersion;
 
 MagicId const MAGIC = 0x24;
+NetVersion const NET_VERSION = 2; // 1: Schemas follow each descriptor; 2: CONSTRUCT carries the path
+
+uint16_t const SERVER_PORT = 9090;
+ClientId const MAX_UDP_CLIENTS = 256; // UDP ports are assigned by client ID
+
+// UDP ports for a client, numbered up from the server's TCP port: the
+// server's port for each client first, and then each client's own port.  Thus,
+// servers on different ports use different UDP ports, as long as their TCP
+// ports are at least 2*MAX_UDP_CLIENTS+1 apart.
+inline uint16_t serverUdpPort(uint16_t port, ClientId id) { return uint16_t(port+1+id); }
+inline uint16_t clientUdpPort(uint16_t port, ClientId id) { return uint16_t(port+1+MAX_UDP_CLIENTS+id); }
 
 class ClientDesc : public Object {
 public:
     Attr<MagicId> magic = MAGIC;
-    Attr<NetVersion> version = NetVersion(0); 
+    Attr<NetVersion> version = NET_VERSION;
     Attr<ClientId> clientId = ClientId(0);
-    SERIALIZED(magic, version, clientId);
+    Attr<uint16_t> udpPort = uint16_t(0); // If nonzero, the client wants UDP
+    Attr<bool> compress = false; // Client wants compressed frames
+    SERIALIZED(magic, version, clientId, udpPort, compress);
 };
 
 class ServerDesc : public Object {
 public:
     Attr<MagicId> magic = MAGIC;
-    Attr<NetVersion> version = NetVersion(0);
-    SERIALIZED(magic, version);
-};
-
-class NetworkInfo : public Model {
-public:
-    // Data regarding the network connection.  This info is used, amongst other
-    // things, to detect the RTT for the connection, as used by the client for
-    // client-side prediction.
-    Attr<uint32_t> pingId;
-    SERIALIZED(pingId);
+    Attr<NetVersion> version = NET_VERSION;
+    Attr<uint16_t> udpPort = uint16_t(0); // If nonzero, UDP was accepted
+    Attr<bool> compress = false; // Frames are compressed in both directions
+    SERIALIZED(magic, version, udpPort, compress);
 };
 
 }
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "jet2/Common.hpp"
+#include "jet2/Object.hpp"
+#include "jet2/Model.hpp"
+#include "jet2/Kernel.hpp"
+
+namespace jet2 {
+
+class MemoryReader;
+class Snapshot;
+
+class Predictor : public virtual TickListener, public Object {
+// Client-side prediction for a model driven by local input.  Each tick, the
+// input model's state is recorded in a history keyed by tickId, and 'step' is
+// applied to the model right away, instead of waiting a round trip for the
+// server.  When an authoritative state for the model arrives, it has
+// overwritten the prediction; the inputs that the server had not yet simulated
+// (those after the model's tickAck) are then replayed on top of it.  'step'
+// must therefore be deterministic, and depend only on the model and input.
+// A DELTA is applied to the last state received (Model::authority), not to
+// the prediction, so the fields it doesn't carry aren't predicted twice.
+public:
+    typedef std::function<void(Ptr<Model> model, Ptr<Model> input)> Step;
+    static size_t const CAPACITY = 128; // Inputs kept, in ticks
+
+    template <typename I>
+    Predictor(Ptr<Model> model, Ptr<I> input, Step step) :
+        Predictor(model, input, std::make_shared<I>(), step) {}
+    virtual ~Predictor();
+    Ptr<Model> model() const { return model_; }
+    Ptr<Model> input() const { return input_; }
+    size_t inputs() const { return history_.size(); } // Not yet acknowledged
+    virtual void tick();
+
+private:
+    Predictor(Ptr<Model> model, Ptr<Model> input, Ptr<Model> replay, Step step);
+    void reconcile();
+
+    struct Input {
+        TickId tick;
+        Ptr<Snapshot const> snapshot;
+    };
+    Ptr<Model> model_;
+    Ptr<Model> input_;
+    Ptr<Model> replay_; // Holds each past input while it is replayed
+    Step step_;
+    std::deque<Input> history_;
+    TickId received_ = 0; // Model::tickId of the last authoritative state
+    Ptr<MemoryReader> reader_;
+    Ptr<Functor> in_;
+};
+
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "jet2/Common.hpp"
+#include "jet2/Functor.hpp"
+
+namespace jet2 {
+
+class BitWriter {
+// Packs values of arbitrary bit width into a byte buffer, least significant
+// bit first.  The packed bytes are then written through a Functor or Writer.
+public:
+    BitWriter(char* buf) : buf_(buf), bits_(0), count_(0) {}
+    void write(uint32_t value, uint8_t bits);
+    void flush();
+
+private:
+    char* buf_;
+    uint64_t bits_;
+    uint8_t count_; // Number of bits pending in bits_
+};
+
+class BitReader {
+// Reads values packed by BitWriter
+public:
+    BitReader(char const* buf) : buf_(buf), bits_(0), count_(0) {}
+    uint32_t read(uint8_t bits);
+
+private:
+    char const* buf_;
+    uint64_t bits_;
+    uint8_t count_;
+};
+
+class QuantizeBounds {
+// The region that quantized positions are encoded in, and the number of bits
+// used for each axis.  Positions outside the bounds are clamped.  At most
+// MAX_BITS bits are used, so that a decoded step is still distinct in a
+// float.
+public:
+    static uint8_t const MAX_BITS = 24;
+
+    QuantizeBounds(sfr::Vector const& min, sfr::Vector const& max, uint8_t bits=16) :
+        min(min), max(max), bits(bits) {
+        assert(bits > 0 && bits <= MAX_BITS);
+    }
+
+    sfr::Vector min;
+    sfr::Vector max;
+    uint8_t bits;
+};
+
+extern QuantizeBounds worldBounds; // Default bounds; must match on both peers
+
+class QuantizedVector {
+// Encodes a position as fixed-point values within the bounds
+public:
+    QuantizedVector(QuantizeBounds const& bounds) : bounds_(bounds) {}
+    size_t size() const { return (3*bounds_.bits+7)/8; }
+    void encode(sfr::Vector const& in, char* out) const;
+    void decode(char const* in, sfr::Vector& out) const;
+
+private:
+    QuantizeBounds bounds_;
+};
+
+class QuantizedQuaternion {
+// Encodes a unit quaternion using "smallest three" compression: the index of
+// the largest component (2 bits), and the other three components with 10 bits
+// each.  The largest component is recomputed from the unit-length constraint.
+public:
+    static uint8_t const BITS = 10;
+    size_t size() const { return 4; }
+    void encode(sfr::Quaternion const& in, char* out) const;
+    void decode(char const* in, sfr::Quaternion& out) const;
+};
+
+inline Encoded<sfr::Vector,QuantizedVector> quantized(Attr<sfr::Vector>& attr, QuantizeBounds const& bounds=worldBounds) {
+// Serialize a position attr as quantized fixed-point values, e.g.:
+// SERIALIZED(quantized(position), quantized(rotation))
+    return Encoded<sfr::Vector,QuantizedVector>(attr, QuantizedVector(bounds));
+}
+
+inline Encoded<sfr::Quaternion,QuantizedQuaternion> quantized(Attr<sfr::Quaternion>& attr) {
+// Serialize a rotation attr using smallest-three compression
+    return Encoded<sfr::Quaternion,QuantizedQuaternion>(attr, QuantizedQuaternion());
+}
+
+}
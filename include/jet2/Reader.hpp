@@ -20,24 +20,110 @@
  * IN THE SOFTWARE.
  */
 
+#pragma once
+
 #include "jet2/Common.hpp"
 #include "jet2/Attr.hpp"
+#include "jet2/Functor.hpp"
 
 namespace jet2 {
 
+class MemoryReader {
+// Reads from a contiguous range of memory, e.g., a received datagram.  Reading
+// past the end of the range fills the output with zeros and sets the error
+// flag, rather than throwing, so that malformed input can be dropped.
+public:
+    MemoryReader() : buf_(0), len_(0), offset_(0), error_(false) {}
+    void bufferIs(char const* buf, size_t len) { buf_ = buf; len_ = len; offset_ = 0; error_ = false; }
+    void read(char* buf, size_t total);
+    uint64_t varint();
+    char const* view(size_t total);
+    void skip(size_t total) { offset_ += std::min(total, remaining()); }
+    char const* data() const { return buf_+offset_; } // Next unread byte
+    size_t remaining() const { return len_-offset_; }
+    bool error() const { return error_; }
+
+private:
+    char const* buf_;
+    size_t len_;
+    size_t offset_;
+    bool error_;
+};
+
+inline void MemoryReader::read(char* buf, size_t total) {
+    if (total > remaining()) {
+        memset(buf, 0, total);
+        offset_ = len_;
+        error_ = true;
+    } else {
+        memcpy(buf, buf_+offset_, total);
+        offset_ += total;
+    }
+}
+
+inline uint64_t MemoryReader::varint() {
+// Reads a varint; see varintEncode().  A truncated varint reads as zero.
+    auto out = uint64_t(0);
+    auto const len = varintDecode(buf_+offset_, remaining(), out);
+    if (!len) {
+        offset_ = len_;
+        error_ = true;
+    }
+    offset_ += len;
+    return out;
+}
+
+inline char const* MemoryReader::view(size_t total) {
+// Returns the next 'total' bytes in place, or null (and sets the error flag)
+// if there aren't enough.
+    if (total > remaining()) {
+        offset_ = len_;
+        error_ = true;
+        return 0;
+    }
+    auto buf = buf_+offset_;
+    offset_ += total;
+    return buf;
+}
+
+class MemoryReadFunctor : public ReadFunctor<MemoryReader> {
+// Decodes fields in place from memory.  Strings are constructed directly from
+// the input, rather than being allocated and then filled.
+public:
+    using Functor::val;
+    using Functor::valVarint;
+    MemoryReadFunctor(Ptr<MemoryReader> fd) : ReadFunctor<MemoryReader>(fd), reader_(fd) {}
+
+    virtual void val(std::string& in) {
+        auto const len = size_t(reader_->varint());
+        auto buf = reader_->view(len);
+        in.assign(buf ? buf : "", buf ? len : 0);
+    }
+
+    virtual void valVarint(uint64_t& in) {
+        in = reader_->varint();
+    }
+
+private:
+    Ptr<MemoryReader> reader_;
+};
+
 template <typename T>
 class Reader {
-// Writes indirectly to a buffer for better performance than writing to the raw
-// file desctiptor.
+// Reads indirectly from a buffer for better performance than reading from the
+// raw file descriptor.  A framed message can be viewed in place with view().
 public:
     Reader(Ptr<T> fd, size_t size=32768);
     virtual ~Reader() {}
 
     void read(char* buf, size_t total);
+    char const* view(size_t total);
     void fill();
     size_t remaining() { return len_-offset_; }
 
 private:
+    void compact();
+
     std::vector<char> buffer_;
     Ptr<T> fd_;
     size_t offset_;
@@ -68,14 +154,48 @@ void Reader<T>::read(char* buf, size_t total) {
     }
 }
 
+template <typename T>
+char const* Reader<T>::view(size_t total) {
+// Returns the next 'total' bytes as a contiguous range in the buffer, reading
+// from the socket as needed, and consumes them.  The range is valid until the
+// next call to the reader.  The buffer grows if 'total' doesn't fit.
+    if (total > buffer_.size()) {
+        buffer_.resize(total);
+    }
+    if (offset_+total > buffer_.size()) {
+        compact();
+    }
+    while (remaining() < total) {
+        fill();
+    }
+    auto buf = &buffer_.front()+offset_;
+    offset_ += total;
+    return buf;
+}
+
 template <typename T>
 void Reader<T>::fill() {
-// Flush to the underlying socket/file descriptor
-    assert(offset_ == len_);
-    len_ = fd_->read(&buffer_.front(), buffer_.size());
-    if (len_ == 0) {
+// Read more data from the underlying socket/file descriptor, after the data
+// that hasn't been consumed yet.
+    if (offset_ == len_) {
+        offset_ = 0;
+        len_ = 0;
+    } else if (len_ == buffer_.size()) {
+        compact();
+    }
+    auto len = fd_->read(&buffer_.front()+len_, buffer_.size()-len_);
+    if (len <= 0) {
         throw coro::SocketCloseException(); // No data read
     }
+    len_ += len;
+}
+
+template <typename T>
+void Reader<T>::compact() {
+// Move the unconsumed data to the front of the buffer
+    auto front = &buffer_.front();
+    memmove(front, front+offset_, remaining());
+    len_ -= offset_;
     offset_ = 0;
 }
 
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "jet2/Common.hpp"
+#include "jet2/Object.hpp"
+#include "jet2/MappedFile.hpp"
+
+namespace jet2 {
+
+class Recorder : public Object {
+// Records the frames sent and received on a connection to an append-only,
+// memory-mapped log.  Each record holds the time, the direction, the frame
+// header fields, and the frame's messages (uncompressed).  The file starts
+// with a magic string; a record whose direction isn't IN or OUT ends the log.
+// The direction is stored last, so a log cut short by a crash is readable up
+// to the last whole record.  A recorder logs one connection, from its first
+// frame, so that the log can be replayed.
+public:
+    enum Direction { END, IN, OUT };
+    static size_t const MIN_CAPACITY = 1 << 20;
+
+    Recorder(std::string const& path);
+    void frameIs(Direction dir, TickId tick, TickId ack, uint32_t messages, char const* data, size_t len);
+    size_t bytes() const { return file_.size(); }
+    uint64_t frames() const { return frames_; } // Frames recorded
+
+private:
+    MappedFile file_;
+    uint64_t frames_ = 0;
+};
+
+class Replay : public Object {
+// Reads the frames recorded by a Recorder, in order
+public:
+    class Frame {
+    public:
+        NetTime time;
+        Recorder::Direction dir;
+        TickId tick;
+        TickId ack;
+        uint32_t messages;
+        char const* data; // Valid while the Replay is alive
+        size_t len;
+    };
+
+    Replay(std::string const& path);
+    bool next(Frame& frame); // Returns false at the end of the log
+    void rewind();
+
+private:
+    MappedFile file_;
+    size_t offset_;
+};
+
+}
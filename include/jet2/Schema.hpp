@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "jet2/Common.hpp"
+#include "jet2/Functor.hpp"
+#include "jet2/Model.hpp"
+
+namespace jet2 {
+
+class Table;
+
+class Schema : public Object {
+// Describes how a model type is encoded: the kind and size of each field, in
+// the order that the type's construct() and visit() functions serialize them.
+// Peers exchange the schemas of their model types in the handshake, and
+// describe types created later in-band, before they are first sent.  If the
+// peer encodes a type differently (e.g., the peer's build appended a field),
+// its messages for that type are decoded by field, and fields that only the
+// peer has are skipped; see SchemaReadFunctor.  Messages for a type the peer
+// never described are refused.
+public:
+    enum Kind { FIXED, VARINT, BYTES };
+    // BYTES is the body of a string; its length is the VARINT that precedes it.
+    typedef uint32_t Field; // Kind in the low two bits; size of a FIXED field above
+
+    static Field field(Kind kind, size_t len=0) { return Field(kind | len << 2); }
+    static Kind kind(Field field) { return Kind(field & 3); }
+    static size_t len(Field field) { return field >> 2; }
+
+    Attr<std::string> type; // Name of the model's type
+    Attr<uint64_t> hash = uint64_t(0); // Of the type name and both field lists
+    std::vector<Field> constructed;
+    std::vector<Field> serialized;
+
+    void hashIs();
+    void visit(Ptr<Functor> out);
+};
+
+class SchemaList : public Object {
+// The schemas sent by a peer in the handshake
+public:
+    std::vector<Ptr<Schema>> schema;
+    void visit(Ptr<Functor> out);
+};
+
+class SchemaReadFunctor : public Functor {
+// Decodes a model that the peer encodes with a different schema.  Fields are
+// matched by position.  A field that both schemas have, with the same kind
+// and size, is read into the model; any other field the peer sent is read and
+// dropped; a field that only the model has keeps its value.  Call finish()
+// after the model is visited, to skip the peer's trailing fields.  Deltas
+// can't be decoded this way, so they are never sent for such types.
+public:
+    using Functor::val;
+    using Functor::valVarint;
+    SchemaReadFunctor(Ptr<Functor> in, std::vector<Schema::Field> const& field) :
+        in_(in), field_(field), index_(0), length_(0) {}
+
+    virtual void val(char* buf, size_t len);
+    virtual void val(std::string& in);
+    virtual void valVarint(uint64_t& in);
+    virtual void valPacked(char* buf, size_t len, uint32_t const* end, size_t fields);
+    void finish();
+
+private:
+    void skip();
+
+    Ptr<Functor> in_;
+    std::vector<Schema::Field> const& field_; // The peer's fields
+    size_t index_; // Next of the peer's fields
+    uint64_t length_; // Last varint read, for a BYTES field
+    std::vector<char> scratch_;
+};
+
+Ptr<Schema const> schema(Model& model);
+Ptr<SchemaList> schemaList(Ptr<Table> db);
+
+}
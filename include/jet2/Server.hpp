@@ -24,25 +24,37 @@
 
 #include "jet2/Common.hpp"
 #include "jet2/Network.hpp"
+#include "jet2/WorkerPool.hpp"
 
 namespace jet2 {
 
 class Player : public Object {
 public:
-    ~Player() { conn()->sd()->close(); }
+    ~Player() { conn()->sd()->close(); if (conn()->udp()) { conn()->udp()->close(); } }
     AttrConst<Ptr<Connection>> conn;
     Attr<ClientId> id = ClientId(0);
     Attr<Ptr<coro::Coroutine>> recv;
     Attr<Ptr<coro::Coroutine>> send;
-    Attr<Ptr<coro::Coroutine>> benchmark;
+    Attr<Ptr<coro::Coroutine>> recvUdp;
 };
 
 class Server : public jet2::Object {
 public:
     Array<Ptr<Player>> player;
     Attr<size_t> maxPlayers;
+    Attr<uint16_t> port = SERVER_PORT; // TCP port; UDP ports are numbered from it
+    Attr<std::string> host; // Local address the server's sockets are bound to
+    Attr<Relevance> relevance; // Area of interest for each player's 'focus'
+    Attr<bool> compress = true; // Accept compression if a client asks for it
+    Attr<size_t> maxUnsent = size_t(64*1024); // Backpressure for each player
     Attr<Ptr<coro::Coroutine>> accept;
     Attr<Ptr<coro::Event>> event = new coro::Event;
+
+    // If set, the models that changed are encoded on the pool once per frame,
+    // and then 'frame' wakes the players' send coroutines.
+    Attr<Ptr<WorkerPool>> workers;
+    Attr<Ptr<coro::Event>> frame = new coro::Event;
+    Attr<Ptr<coro::Coroutine>> encode;
 };
 
 }
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "jet2/Common.hpp"
+#include "jet2/Functor.hpp"
+
+namespace jet2 {
+
+class Snapshot : public Functor {
+// Records the encoded state of a model at one point in time.  Each primitive
+// value written by the model's visit() function is recorded as a separate
+// field, so that two snapshots of the same model can be compared field by
+// field to produce a delta.  The concatenated fields are byte-for-byte what a
+// WriteFunctor would have written for the same model.
+public:
+    using Functor::val;
+    using Functor::valVarint;
+    void clear() { data_.clear(); end_.clear(); }
+    char const* data() const { return data_.empty() ? 0 : &data_.front(); }
+    size_t size() const { return data_.size(); }
+    size_t fields() const { return end_.size(); }
+    char const* field(size_t index) const { return data()+fieldOffset(index); }
+    size_t fieldOffset(size_t index) const { return index ? end_[index-1] : 0; }
+    size_t fieldLen(size_t index) const { return end_[index]-fieldOffset(index); }
+    bool fieldEq(Snapshot const& other, size_t index) const;
+    bool operator==(Snapshot const& other) const;
+    void deltaOut(Ptr<Functor> out, Snapshot const& base) const;
+
+    virtual void val(char* buf, size_t len) {
+        data_.insert(data_.end(), buf, buf+len);
+        end_.push_back(uint32_t(data_.size()));
+    }
+
+    virtual void valVarint(uint64_t& in) {
+        char buf[VARINT_MAX];
+        val(buf, varintEncode(in, buf)); // One field, whatever its length
+    }
+
+    virtual void valPacked(char* buf, size_t len, uint32_t const* end, size_t fields) {
+        auto const base = uint32_t(data_.size());
+        data_.insert(data_.end(), buf, buf+len);
+        for (size_t i = 0; i < fields; ++i) {
+            end_.push_back(base+end[i]);
+        }
+    }
+
+private:
+    std::vector<char> data_;
+    std::vector<uint32_t> end_; // End offset of each field
+};
+
+class DeltaReadFunctor : public Functor {
+// Reads a delta-encoded model written by writeDelta().  Fields are grouped
+// eight at a time, and each group is preceded by a bitmask of the fields that
+// changed.  Unchanged fields are skipped, so the model keeps the value it
+// received in the last message, which is the baseline the sender compared
+// against.
+public:
+    using Functor::val;
+    using Functor::valVarint;
+    DeltaReadFunctor(Ptr<Functor> in) : in_(in), field_(0), mask_(0) {}
+    void reset() { field_ = 0; }
+
+    virtual void val(char* buf, size_t len) {
+        if (field_ % 8 == 0) {
+            in_->val(mask_);
+        }
+        if (mask_ & (1 << (field_ % 8))) {
+            in_->val(buf, len);
+        }
+        ++field_;
+    }
+
+    virtual void valVarint(uint64_t& in) {
+        // A varint is one field, but its length is only known once it's read
+        if (field_ % 8 == 0) {
+            in_->val(mask_);
+        }
+        if (mask_ & (1 << (field_ % 8))) {
+            in_->valVarint(in);
+        }
+        ++field_;
+    }
+
+    virtual void valPacked(char* buf, size_t len, uint32_t const* end, size_t fields) {
+        // Unchanged fields keep their packed (current) value
+        auto begin = uint32_t(0);
+        for (size_t i = 0; i < fields; ++i) {
+            val(buf+begin, end[i]-begin);
+            begin = end[i];
+        }
+    }
+
+private:
+    Ptr<Functor> in_;
+    size_t field_;
+    uint8_t mask_;
+};
+
+inline bool Snapshot::fieldEq(Snapshot const& other, size_t index) const {
+// Returns true if field 'index' has the same encoding in both snapshots
+    auto const len = fieldLen(index);
+    return len == other.fieldLen(index) && !memcmp(field(index), other.field(index), len);
+}
+
+inline bool Snapshot::operator==(Snapshot const& other) const {
+// Returns true if both snapshots have identical fields
+    return end_ == other.end_ && data_ == other.data_;
+}
+
+inline void Snapshot::deltaOut(Ptr<Functor> out, Snapshot const& base) const {
+// Writes the fields that differ from 'base' to 'out', in the format read by
+// DeltaReadFunctor.  Both snapshots must come from the same model type.
+    assert(fields() == base.fields());
+    for (size_t group = 0; group < fields(); group += 8) {
+        auto const end = std::min(group+8, fields());
+        auto mask = uint8_t(0);
+        for (auto i = group; i < end; ++i) {
+            if (!fieldEq(base, i)) {
+                mask |= uint8_t(1 << (i-group));
+            }
+        }
+        out->val(mask);
+        for (auto i = group; i < end; ++i) {
+            if (mask & (1 << (i-group))) {
+                out->val((char*)field(i), fieldLen(i));
+            }
+        }
+    }
+}
+
+}
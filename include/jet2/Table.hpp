@@ -25,6 +25,7 @@
 #include "jet2/Common.hpp"
 #include "jet2/Object.hpp"
 #include "jet2/Attr.hpp"
+#include "jet2/Model.hpp"
 
 namespace jet2 {
 
@@ -65,6 +66,23 @@ private:
     std::type_info const& type_;
 };
 
+class Table;
+
+typedef std::function<Ptr<Model>(Table& table, std::string const& path)> ModelFactory;
+// Creates a model of one type at 'path' in 'table', so that a connection can
+// spawn the models its peer constructs; see Connection::spawn.  Factories are
+// registered by type name, as typeid() gives it.
+
+void modelFactoryIs(std::string const& type, ModelFactory const& factory);
+ModelFactory modelFactory(std::string const& type);
+
+template <typename T>
+typename std::enable_if<std::is_default_constructible<T>::value>::type modelTypeIs();
+
+template <typename T>
+typename std::enable_if<!std::is_default_constructible<T>::value>::type modelTypeIs() {}
+// A type that needs constructor args can't be spawned
+
 class Table : public Object {
 // Contains a database of objects for the game, listed by long path name.  In
 // addition, the Table can automatically synchronize with a remote Table.
@@ -87,9 +105,18 @@ public:
     template <typename T>
     Ptr<T> object(char const* path);
 
+    void objectDel(std::string const& path) { objectDel(path.c_str()); }
+    void objectDel(char const* path);
+
     Coll::iterator begin() { return object_.begin(); }
     Coll::iterator end() { return object_.end(); }
 
+    Ptr<ModelTable> registry() const { return registry_; }
+    void registryIs(Ptr<ModelTable> registry) { registry_ = registry; }
+    // Models created in this table (or in tables created beneath it) are
+    // added to the registry, if one is set.
+    std::string const& path() const { return path_; } // e.g., "models/"
+
 private:
     template <typename T, typename... Arg>
     Ptr<T> leafIs(std::string const& name, Arg const&...arg);
@@ -97,9 +124,42 @@ private:
     template <typename T>
     Ptr<T> leafIs(std::string const& name);
 
+    template <typename T>
+    typename std::enable_if<std::is_base_of<Model,T>::value>::type
+    registerObject(std::string const& name, Ptr<T> object) {
+        static bool const registered = (modelTypeIs<T>(), true);
+        (void)registered;
+        if (registry_) { registry_->modelIs(object, this, name); }
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_same<Table,T>::value>::type
+    registerObject(std::string const& name, Ptr<T> object) {
+        object->path_ = path_+name+"/";
+        object->registryIs(registry_);
+    }
+
+    template <typename T>
+    typename std::enable_if<!std::is_base_of<Model,T>::value && !std::is_same<Table,T>::value>::type
+    registerObject(std::string const& name, Ptr<T> object) {}
+
+    void unregisterObject(TableEntry& entry);
+
     Coll object_;
+    Ptr<ModelTable> registry_;
+    std::string path_; // Path from the root table, ending with '/'
 };
 
+template <typename T>
+typename std::enable_if<std::is_default_constructible<T>::value>::type modelTypeIs() {
+    // Register a factory for T.  Table::objectIs() does this for each model
+    // type it creates, so only types that a process may receive before it
+    // creates one itself need to be registered up front.
+    modelFactoryIs(typeid(T).name(), [](Table& table, std::string const& path) -> Ptr<Model> {
+        return table.objectIs<T>(path);
+    });
+}
+
 template <typename T, typename... Arg>
 Ptr<T> Table::leafIs(std::string const& name, Arg const&...arg) {
     // Instantiate an object with constructor args.  If another object already
@@ -108,6 +168,7 @@ Ptr<T> Table::leafIs(std::string const& name, Arg const&...arg) {
     if (entry == object_.end()) {
         auto object = std::make_shared<T>(arg...);
         object_.insert(std::make_pair(name, TableEntry(object)));
+        registerObject(name, object);
         return object;
     } else {
         throw TableException("object '"+name+"' already exists");
@@ -123,6 +184,7 @@ Ptr<T> Table::leafIs(std::string const& name) {
     if (entry == object_.end()) {
         auto object = std::make_shared<T>();
         object_.insert(std::make_pair(name, TableEntry(object)));
+        registerObject(name, object);
         return object;
     } else if (Ptr<T> object = entry->second.cast<T>()) {
         return object;        
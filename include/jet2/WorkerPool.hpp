@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "jet2/Common.hpp"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace jet2 {
+
+class WorkerPool {
+// A fixed set of threads for CPU-bound work that can be split into
+// independent tasks, e.g., encoding the models that changed in a frame.  The
+// caller blocks in run() until every task is done, so tasks may read state
+// owned by the caller's thread as long as they don't share what they write.
+public:
+    typedef std::function<void (size_t)> Task;
+
+    WorkerPool(size_t threads);
+    ~WorkerPool();
+    void run(size_t count, Task const& task); // Runs task(0) .. task(count-1)
+    size_t threads() const { return thread_.size(); }
+
+private:
+    void work();
+    bool next(uint64_t batch, size_t& index);
+
+    std::vector<std::thread> thread_;
+    std::mutex mutex_;
+    std::condition_variable workAvailable_;
+    std::condition_variable workDone_;
+    Task const* task_ = nullptr;
+    size_t count_ = 0; // Number of tasks in the current batch
+    size_t next_ = 0; // Next task to start
+    size_t done_ = 0; // Number of tasks finished
+    uint64_t batch_ = 0;
+    bool exit_ = false;
+};
+
+}
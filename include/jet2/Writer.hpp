@@ -20,31 +20,144 @@
  * IN THE SOFTWARE.
  */
 
+#pragma once
+
 #include "jet2/Common.hpp"
 #include "jet2/Attr.hpp"
 
+#ifndef _WIN32
+#include <sys/uio.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#ifdef __linux__
+#include <linux/sockios.h>
+#endif
+#include <climits>
+#include <cerrno>
+#endif
+
 namespace jet2 {
 
+#ifndef _WIN32
+template <typename F>
+class HasFileno {
+// True if F exposes its raw descriptor, so that the Writer can use vectored
+// writes and query the send queue.
+    template <typename G> static char test(decltype(std::declval<G const&>().fileno())*);
+    template <typename G> static long test(...);
+public:
+    static bool const value = sizeof(test<F>(0)) == sizeof(char);
+};
+
+template <typename F>
+auto writev(F& fd, iovec const* iov, int count, int) -> decltype(fd.fileno(), ssize_t()) {
+// Writes as much as the descriptor accepts without blocking.  Errors are left
+// to the blocking writeAll() that sends the rest.  Sockets are written with
+// sendmsg(), so that a closed peer raises an error rather than SIGPIPE; on
+// platforms without MSG_NOSIGNAL, the socket must set SO_NOSIGPIPE instead.
+#ifdef MSG_NOSIGNAL
+    msghdr msg = msghdr();
+    msg.msg_iov = const_cast<iovec*>(iov);
+    msg.msg_iovlen = count;
+    auto const written = ::sendmsg(fd.fileno(), &msg, MSG_NOSIGNAL);
+    if (written >= 0 || errno != ENOTSOCK) {
+        return written;
+    }
+#endif
+    return ::writev(fd.fileno(), iov, count);
+}
+
+template <typename F>
+ssize_t writev(F& fd, iovec const* iov, int count, long) {
+    return 0; // No raw descriptor; each segment is sent with writeAll()
+}
+
+template <typename F>
+auto unsent(F& fd, int) -> decltype(fd.fileno(), size_t()) {
+// Returns the bytes written to the descriptor that the kernel hasn't sent
+// yet, or zero if the platform can't tell.  Bytes sent but not yet acked
+// aren't counted, so a long round trip doesn't look like a slow peer.  Where
+// the kernel can't separate the two (macOS, and Linux before 2.6.38), the
+// count includes unacked bytes.
+    auto bytes = 0;
+#if defined(__linux__) && defined(SIOCOUTQNSD)
+    if (ioctl(fd.fileno(), SIOCOUTQNSD, &bytes) != 0) {
+        return 0;
+    }
+#elif defined(__linux__)
+    if (ioctl(fd.fileno(), TIOCOUTQ, &bytes) != 0) {
+        return 0;
+    }
+#elif defined(__APPLE__)
+    auto len = socklen_t(sizeof(bytes));
+    if (getsockopt(fd.fileno(), SOL_SOCKET, SO_NWRITE, &bytes, &len) != 0) {
+        return 0;
+    }
+#endif
+    return size_t(std::max(bytes, 0));
+}
+
+template <typename F>
+size_t unsent(F& fd, long) {
+    return 0;
+}
+#endif
+
+class MemoryWriter {
+// Writes to a growable buffer in memory, e.g., a message that must be complete
+// before its length can be written.
+public:
+    void write(char* buf, size_t total) { buffer_.insert(buffer_.end(), buf, buf+total); }
+    void clear() { buffer_.clear(); }
+    char const* data() const { return buffer_.empty() ? 0 : &buffer_.front(); }
+    size_t size() const { return buffer_.size(); }
+
+private:
+    std::vector<char> buffer_;
+};
+
 template <typename T>
 class Writer {
 // Writes indirectly to a buffer for better performance than writing to the raw
-// file desctiptor.
+// file desctiptor.  Callers may also queue external segments, which are sent
+// in order with the buffered data on the next flush without being copied.
 public:
     Writer(Ptr<T> fd, size_t size=32768);
     virtual ~Writer() {}
 
     void write(char* buf, size_t total);
+    void segmentIs(Ptr<void const> owner, char const* buf, size_t len);
+    size_t reserve(size_t len);
+    void reservedIs(size_t offset, char const* buf, size_t len);
+    void reservedDel(size_t offset, size_t len);
+    void tail(size_t offset, std::vector<char>& out);
     void flush();
     size_t remaining() { return buffer_.size()-len_; }
+    uint64_t bytes() const { return bytes_; } // Total bytes written
+    size_t unsent() const; // Bytes flushed that the kernel hasn't sent yet
+
+    static size_t const MIN_SEGMENT = 256; // Smaller segments are copied
 
 private:
+    struct Segment {
+        size_t offset; // Buffered bytes that precede the segment
+        Ptr<void const> owner; // Keeps the segment's memory alive
+        char const* data;
+        size_t len;
+    };
+
+    void writeAll(char const* buf, size_t len);
+
     std::vector<char> buffer_;
+    std::vector<Segment> segment_;
     Ptr<T> fd_;
     size_t len_;
+    uint64_t bytes_;
+    size_t reserved_; // Reserved ranges not yet filled in
 };
 
 template <typename T>
-Writer<T>::Writer(Ptr<T> fd, size_t size) : fd_(fd), len_(0) {
+Writer<T>::Writer(Ptr<T> fd, size_t size) : fd_(fd), len_(0), bytes_(0), reserved_(0) {
 // Allocate space for the buffer
     buffer_.resize(size);
 }
@@ -52,29 +165,175 @@ Writer<T>::Writer(Ptr<T> fd, size_t size) : fd_(fd), len_(0) {
 template <typename T>
 void Writer<T>::write(char* buf, size_t total) {
 // Write buf to the internal buffer.  When the buffer is full, flush it to the
-// underlying socket/file descriptor
+// underlying socket/file descriptor.  Writes at least as large as the buffer
+// are sent directly after any data queued before them.  While a range is
+// reserved, nothing can be flushed, so the buffer grows instead.
+    if (reserved_) {
+        if (total > remaining()) {
+            buffer_.resize(std::max(2*buffer_.size(), len_+total));
+        }
+        memcpy(&buffer_.front()+len_, buf, total);
+        len_ += total;
+        bytes_ += total;
+        return;
+    }
+    if (total >= buffer_.size()) {
+        segmentIs(Ptr<void const>(), buf, total);
+        flush(); // The caller's buffer isn't owned, so send it now
+        return;
+    }
+    bytes_ += total;
     while (total > 0) {
-        if (len_ && total >= buffer_.capacity()) {
-            fd_->writeAll(buf, total);  // Shortcut for large writes
-        } else {
-            auto len = std::min(total, remaining());
-            auto front = &buffer_.front();
-            memcpy(front+len_, buf, len);
-            total -= len;
-            buf += len;
-            len_ += len;
-            if (remaining() == 0) {
-                flush();
-            }
+        auto len = std::min(total, remaining());
+        auto front = &buffer_.front();
+        memcpy(front+len_, buf, len);
+        total -= len;
+        buf += len;
+        len_ += len;
+        if (remaining() == 0) {
+            flush();
         }
     }
 }
 
+template <typename T>
+void Writer<T>::segmentIs(Ptr<void const> owner, char const* buf, size_t len) {
+// Queue 'len' bytes at 'buf' to be sent without copying.  'owner' is held
+// until the next flush, and must keep the bytes alive and unmodified.
+    if (len < MIN_SEGMENT && len < remaining()) {
+        write((char*)buf, len); // Cheaper to copy than to add an iovec
+        return;
+    }
+    bytes_ += len;
+    Segment segment = { len_, owner, buf, len };
+    segment_.push_back(segment);
+}
+
+template <typename T>
+size_t Writer<T>::reserve(size_t len) {
+// Reserve 'len' bytes, e.g., for a header whose contents depend on what is
+// written after it, and return the range's offset.  Until the range is filled
+// in with reservedIs() or removed with reservedDel(), the writer holds all
+// data in memory.
+    if (!reserved_ && len > remaining()) {
+        flush();
+    }
+    if (len > remaining()) {
+        buffer_.resize(len_+len);
+    }
+    auto const offset = len_;
+    memset(&buffer_.front()+offset, 0, len);
+    len_ += len;
+    bytes_ += len;
+    ++reserved_;
+    return offset;
+}
+
+template <typename T>
+void Writer<T>::reservedIs(size_t offset, char const* buf, size_t len) {
+// Fill in a reserved range
+    assert(reserved_ && offset+len <= len_);
+    memcpy(&buffer_.front()+offset, buf, len);
+    --reserved_;
+}
+
+template <typename T>
+void Writer<T>::reservedDel(size_t offset, size_t len) {
+// Remove a reserved range.  Nothing may have been written after it.
+    assert(reserved_ && offset+len == len_);
+    assert(segment_.empty() || segment_.back().offset <= offset);
+    len_ = offset;
+    bytes_ -= len;
+    --reserved_;
+}
+
+template <typename T>
+void Writer<T>::tail(size_t offset, std::vector<char>& out) {
+// Move everything written after buffer offset 'offset' to 'out', including
+// queued segments, e.g., to compress it.  A reserved range must end at or
+// before 'offset', so that none of the data has been flushed.
+    assert(reserved_ && offset <= len_);
+    auto const start = out.size();
+    auto first = segment_.begin();
+    while (first != segment_.end() && first->offset < offset) {
+        ++first;
+    }
+    auto pos = offset;
+    for (auto segment = first; segment != segment_.end(); ++segment) {
+        out.insert(out.end(), buffer_.data()+pos, buffer_.data()+segment->offset);
+        out.insert(out.end(), segment->data, segment->data+segment->len);
+        pos = segment->offset;
+    }
+    out.insert(out.end(), buffer_.data()+pos, buffer_.data()+len_);
+    segment_.erase(first, segment_.end());
+    bytes_ -= out.size()-start;
+    len_ = offset;
+}
+
+template <typename T>
+size_t Writer<T>::unsent() const {
+#ifdef _WIN32
+    return 0;
+#else
+    return fd_ ? jet2::unsent(*fd_, 0) : 0;
+#endif
+}
+
 template <typename T>
 void Writer<T>::flush() {
-// Flush to the underlying socket/file descriptor
-    fd_->writeAll(&buffer_.front(), len_);
+// Flush to the underlying socket/file descriptor, interleaving the buffered
+// data with the queued segments, in a single vectored write if possible.
+    assert(!reserved_ && "flushed with a reserved range");
+    if (segment_.empty()) {
+        writeAll(&buffer_.front(), len_);
+        len_ = 0;
+        return;
+    }
+#ifndef _WIN32
+    std::vector<iovec> iov;
+    iov.reserve(2*segment_.size()+1);
+    auto offset = size_t(0);
+    for (auto& segment : segment_) {
+        if (segment.offset > offset) {
+            iovec buffered = { &buffer_.front()+offset, segment.offset-offset };
+            iov.push_back(buffered);
+            offset = segment.offset;
+        }
+        iovec external = { (void*)segment.data, segment.len };
+        iov.push_back(external);
+    }
+    if (len_ > offset) {
+        iovec buffered = { &buffer_.front()+offset, len_-offset };
+        iov.push_back(buffered);
+    }
+    auto count = int(std::min(iov.size(), size_t(IOV_MAX)));
+    auto written = std::max(writev(*fd_, &iov.front(), count, 0), ssize_t(0));
+    for (auto next = iov.begin(); next != iov.end(); ++next) {
+        auto const len = size_t(written) < next->iov_len ? next->iov_len-written : 0;
+        if (len) {
+            // The socket buffer is full; the coroutine blocks in writeAll()
+            writeAll((char const*)next->iov_base+next->iov_len-len, len);
+        }
+        written = std::max(written-ssize_t(next->iov_len), ssize_t(0));
+    }
+#else
+    auto offset = size_t(0);
+    for (auto& segment : segment_) {
+        writeAll(&buffer_.front()+offset, segment.offset-offset);
+        writeAll(segment.data, segment.len);
+        offset = segment.offset;
+    }
+    writeAll(&buffer_.front()+offset, len_-offset);
+#endif
+    segment_.clear();
     len_ = 0;
 }
 
+template <typename T>
+void Writer<T>::writeAll(char const* buf, size_t len) {
+    if (len) {
+        fd_->writeAll(buf, len);
+    }
+}
+
 }
@@ -33,11 +33,19 @@
 #include "jet2/Exception.hpp"
 #include "jet2/Functions.hpp"
 #include "jet2/Hash.hpp"
+#include "jet2/Interpolator.hpp"
 #include "jet2/Kernel.hpp"
 #include "jet2/Network.hpp"
 #include "jet2/Menu.hpp"
 #include "jet2/Model.hpp"
+#include "jet2/NetClock.hpp"
+#include "jet2/NetSim.hpp"
+#include "jet2/Predictor.hpp"
 #include "jet2/Object.hpp"
+#include "jet2/Quantize.hpp"
+#include "jet2/Recorder.hpp"
+#include "jet2/Schema.hpp"
 #include "jet2/Server.hpp"
+#include "jet2/Snapshot.hpp"
 #include "jet2/Table.hpp"
 #include "jet2/View.hpp"
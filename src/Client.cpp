@@ -30,7 +30,7 @@
 using namespace jet2;
 
 static void send(Ptr<Connection> conn, Ptr<Table> table) {
-// Send game data continuously, once per timestep.  Also, periodically send a ping in concert with a
+// Send game data continuously, once per netTimestep
     try {
         jet2::send(conn, table);
     } catch (coro::SocketCloseException const&){
@@ -46,82 +46,83 @@ static void recv(Ptr<Connection> conn, Ptr<Table> table) {
     }
 }
 
-static void benchmark(Ptr<Connection> conn, Ptr<Table> table) {
-// Collects performance info regarding the connection, for use in client-side
-// prediction.  In particular, this coroutine sends a ping, waits for a
-// response from the server, and uses that information to estimate the 1/2 RTT
-// value.  This value is used to extrapolate the position of objects given
-// their velocity, to achieve a better estimate of the position of each object.
-    auto in = table->objectIs<NetworkInfo>("remotes/netinfo");
-    auto out = table->objectIs<NetworkInfo>("input/netinfo");
-
-    in->netMode = Model::INPUT; 
-    out->netMode = Model::OUTPUT;
-
-    auto rttEstimate = 0.0;
-    auto mix = 0.5;
-    auto timer = sf::Clock();
-
-    // FIXME: Move all this code into jet2, and add events for net send/recv
-    for (;;) {
-        out->pingId = out->pingId() + 1; 
-        out->syncMode = Model::ONCE;
-        std::cout << "sending" << std::endl;
-        std::cout << out->pingId() << ',' << in->pingId() << std::endl;
-        sendMessage(conn, out);
-        timer.restart(); 
-        conn->writer()->flush(); // Ensure immediate send
-        while (in->pingId() < out->pingId()) {
-            in->wait();
-        }
-        std::cout << out->pingId() << ',' << in->pingId() << std::endl;
-        
-        auto delta = timer.getElapsedTime().asSeconds();
-        rttEstimate = mix*rttEstimate + (1-mix)*delta;
-
-        jet2::netDelta = coro::Time::sec(rttEstimate);
-        // Divide by 2?
-        std::cout << "rtt=" << rttEstimate << std::endl;
-
-        coro::sleep(coro::Time::sec(1));
+static void recvUdp(Ptr<Connection> conn, Ptr<Table> table) {
+    try {
+        jet2::recvDatagram(conn, table);
+    } catch (coro::SocketCloseException const&){
+        log("error: connection to server closed");
     }
 }
 
-static void connect(Ptr<Client> client, Ptr<Table> table) {
-// Connect or reconnect client to the server
+static void connect(Ptr<Client> client, Ptr<Table> table, bool udp, bool compress, std::string const& host, uint16_t port) {
+// Connect or reconnect client to the server.  If 'udp' is set, then request
+// an unreliable channel for SYNC updates (only for client IDs below
+// MAX_UDP_CLIENTS).  If 'compress' is set, then request compressed frames.
     auto sd = std::make_shared<coro::Socket>();
     auto serverDesc = std::make_shared<ServerDesc>();
     auto clientDesc = std::make_shared<ClientDesc>();
     auto conn = std::make_shared<Connection>(sd);
+    conn->spawn = true; // Models the server creates appear in 'remotes'
+    auto udpSd = Ptr<coro::Socket>();
 
     clientDesc->clientId = client->id;
+    clientDesc->compress = compress;
     serverDesc->magic = 0;
+    if (udp && client->id() < MAX_UDP_CLIENTS) {
+        clientDesc->udpPort = clientUdpPort(port, client->id());
+        udpSd = datagramSocket(clientDesc->udpPort(), "0.0.0.0"); // Reachable from 'host'
+    }
 
-    sd->connect(coro::SocketAddr("127.0.0.1", 9090));  
+    sd->connect(coro::SocketAddr(host, port));
     sd->setsockopt(IPPROTO_TCP, TCP_NODELAY, true);
 
     conn->out()->val(clientDesc);
+    sendSchemas(conn, table);
     conn->writer()->flush();
     conn->in()->val(serverDesc);
     assert(serverDesc->magic() == jet2::MAGIC);
+    if (serverDesc->version() != NET_VERSION) {
+        std::cerr << "error: server version " << (uint32_t)serverDesc->version() << " unsupported" << std::endl;
+        sd->close();
+        throw coro::SocketCloseException(); // No schemas follow
+    }
+    recvSchemas(conn);
+    conn->compress = serverDesc->compress();
+    if (udpSd && serverDesc->udpPort()) {
+        udpSd->connect(coro::SocketAddr(host, serverDesc->udpPort()));
+        conn->udp = udpSd;
+    }
 
     auto remotes = table->objectIs<Table>("remotes");
     auto input = table->objectIs<Table>("input");
 
     client->conn = conn;
-    client->benchmark = coro::start([=] { benchmark(conn, table); } );
+    jet2::serverClock = conn->clock();
     client->send = coro::start([=]{ ::send(conn, input); });
     client->recv = coro::start([=]{ ::recv(conn, remotes); });
+    if (conn->udp()) {
+        client->recvUdp = coro::start([=]{ ::recvUdp(conn, remotes); });
+    }
 }
 
 
 namespace jet2 {
 
-Ptr<Client> client(Ptr<Table> table, ClientId id) {
+Client::~Client() {
+    if (!conn()) {
+        return;
+    }
+    conn()->sd()->close();
+    if (conn()->udp()) {
+        conn()->udp()->close();
+    }
+}
+
+Ptr<Client> client(Ptr<Table> table, ClientId id, bool udp, bool compress, std::string const& host, uint16_t port) {
 // Connect to server
     auto client = std::make_shared<Client>();
     client->id = id;
-    connect(client, table);
+    connect(client, table, udp, compress, host, port);
     return client;
 }
 
@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "jet2/Common.hpp"
+#include "jet2/Compress.hpp"
+#include <chrono>
+
+namespace jet2 {
+
+size_t const Compressor::MIN_MATCH;
+size_t const Compressor::MAX_OFFSET; // Bound by reference in std::min
+size_t const Compressor::HASH_BITS;
+
+static uint32_t hash(char const* buf) {
+// Hash of the MIN_MATCH bytes at 'buf'
+    auto value = uint32_t(0);
+    memcpy(&value, buf, sizeof(value));
+    return (value*2654435761u) >> (32-Compressor::HASH_BITS);
+}
+
+static void lengthOut(std::vector<char>& out, size_t len) {
+// Write the part of a length that didn't fit in its token nibble
+    while (len >= 255) {
+        out.push_back(char(255));
+        len -= 255;
+    }
+    out.push_back(char(len));
+}
+
+static void sequenceOut(std::vector<char>& out, char const* literal, size_t literals, size_t offset, size_t match) {
+// Write literals followed by a match.  A match length of zero marks the last
+// sequence, which has no offset.
+    auto const matchCode = match ? match-Compressor::MIN_MATCH : 0;
+    out.push_back(char((std::min(literals, size_t(15)) << 4) | std::min(matchCode, size_t(15))));
+    if (literals >= 15) {
+        lengthOut(out, literals-15);
+    }
+    out.insert(out.end(), literal, literal+literals);
+    if (match) {
+        out.push_back(char(offset & 0xff));
+        out.push_back(char(offset >> 8));
+        if (matchCode >= 15) {
+            lengthOut(out, matchCode-15);
+        }
+    }
+}
+
+void Compressor::dictionaryIs(char const* buf, size_t len) {
+// Use the last MAX_OFFSET bytes of 'buf' as the dictionary for the next frame.
+// The dictionary is placed after the old window in the stream, so it gets
+// hashed by the next compress(); any stale hash entry is still checked
+// against the window before it's used.
+    auto const keep = std::min(len, MAX_OFFSET);
+    origin_ += window_.size();
+    hashed_ = origin_;
+    window_.assign(buf+len-keep, buf+len);
+    dictionary_ = keep;
+}
+
+void Compressor::compress(char const* in, size_t len, std::vector<char>& out) {
+// Compress 'len' bytes at 'in', appending the result to 'out'.  The frame then
+// becomes the dictionary for the next call.  The hash table is kept across
+// calls and indexed by stream position, so each byte is hashed once, when
+// it's compressed, rather than again with every frame it's a dictionary for.
+// Entries that fall outside the window are skipped.
+    auto const start = std::chrono::steady_clock::now();
+    auto const outStart = out.size();
+    window_.resize(dictionary_);
+    window_.insert(window_.end(), in, in+len);
+    if (hash_.empty()) {
+        hash_.resize(size_t(1) << HASH_BITS);
+    }
+
+    auto const base = window_.data();
+    auto const end = window_.size();
+    for (auto i = size_t(std::max(hashed_, origin_)-origin_); i < dictionary_ && i+MIN_MATCH <= end; ++i) {
+        hash_[hash(base+i)] = uint32_t(origin_+i+1); // Dictionary bytes not hashed yet
+    }
+
+    auto pos = dictionary_;
+    auto literal = dictionary_;
+    while (pos+MIN_MATCH <= end) {
+        auto& slot = hash_[hash(base+pos)];
+        auto const distance = size_t(uint32_t(origin_+pos+1)-slot);
+        auto const candidate = slot;
+        slot = uint32_t(origin_+pos+1);
+        if (!candidate || !distance || distance > MAX_OFFSET || distance > pos || memcmp(base+pos-distance, base+pos, MIN_MATCH)) {
+            ++pos;
+            continue;
+        }
+        auto const ref = pos-distance;
+        auto match = MIN_MATCH;
+        while (pos+match < end && base[ref+match] == base[pos+match]) {
+            ++match;
+        }
+        sequenceOut(out, base+literal, pos-literal, distance, match);
+        for (auto i = pos+1; i < pos+match && i+MIN_MATCH <= end; ++i) {
+            hash_[hash(base+i)] = uint32_t(origin_+i+1);
+        }
+        pos += match;
+        literal = pos;
+    }
+    sequenceOut(out, base+literal, end-literal, 0, 0);
+
+    // Positions in the last MIN_MATCH-1 bytes are hashed with the next frame
+    hashed_ = std::max(hashed_, origin_+std::max(end, MIN_MATCH-1)-(MIN_MATCH-1));
+    auto const keep = std::min(len, MAX_OFFSET);
+    window_.erase(window_.begin(), window_.end()-keep);
+    origin_ += end-keep;
+    dictionary_ = keep;
+    auto const elapsed = std::chrono::steady_clock::now()-start;
+    nanosec_ += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    bytesIn_ += len;
+    bytesOut_ += out.size()-outStart;
+}
+
+static bool lengthIn(char const*& in, char const* end, size_t& len) {
+// Read the extra bytes of a length whose token nibble was 15
+    for (;;) {
+        if (in == end) {
+            return false;
+        }
+        auto const byte = uint8_t(*in++);
+        len += byte;
+        if (byte != 255) {
+            return true;
+        }
+    }
+}
+
+bool Decompressor::decompress(char const* in, size_t len, size_t rawLen) {
+// Decompress one frame, which is then available from data().  Returns false
+// if the input is malformed, or would decompress to more than 'rawLen' bytes.
+// The caller must bound 'rawLen', since it is reserved up front.
+    auto const end = in+len;
+    auto const keep = std::min(size(), Compressor::MAX_OFFSET);
+    if (keep) {
+        window_.erase(window_.begin(), window_.end()-keep);
+    } else {
+        window_.clear();
+    }
+    dictionary_ = window_.size();
+    window_.reserve(dictionary_+rawLen);
+
+    while (in < end) {
+        auto const token = uint8_t(*in++);
+        auto literals = size_t(token >> 4);
+        if (literals == 15 && !lengthIn(in, end, literals)) {
+            return false;
+        }
+        if (size_t(end-in) < literals || literals > rawLen-size()) {
+            return false;
+        }
+        window_.insert(window_.end(), in, in+literals);
+        in += literals;
+        if (in == end) {
+            break; // Last sequence
+        }
+        if (end-in < 2) {
+            return false;
+        }
+        auto const offset = size_t(uint8_t(in[0])) | (size_t(uint8_t(in[1])) << 8);
+        in += 2;
+        auto match = size_t(token & 0xf);
+        if (match == 15 && !lengthIn(in, end, match)) {
+            return false;
+        }
+        match += Compressor::MIN_MATCH;
+        if (!offset || offset > window_.size() || match > rawLen-size()) {
+            return false;
+        }
+        auto ref = window_.size()-offset;
+        for (size_t i = 0; i < match; ++i) {
+            window_.push_back(window_[ref+i]); // May overlap the output
+        }
+    }
+    return size() == rawLen;
+}
+
+}
@@ -25,13 +25,33 @@
 
 namespace jet2 {
 
+#ifndef _WIN32
+static_assert(HasFileno<coro::Socket>::value, "Writer needs coro::Socket::fileno() for vectored writes");
+#endif
+
 Connection::Connection(Ptr<coro::Socket> sd) :
     sd(sd),
     writer(std::make_shared<Writer<coro::Socket>>(sd)),
     reader(std::make_shared<Reader<coro::Socket>>(sd)),
     out(Ptr<Functor>(new WriteFunctor<Writer<coro::Socket>>(writer()))),
-    in(Ptr<Functor>(new ReadFunctor<Reader<coro::Socket>>(reader()))) {
+    in(Ptr<Functor>(new ReadFunctor<Reader<coro::Socket>>(reader()))),
+    messageWriter(std::make_shared<MemoryWriter>()),
+    messageOut(Ptr<Functor>(new WriteFunctor<MemoryWriter>(messageWriter()))),
+    messageReader(std::make_shared<MemoryReader>()),
+    frameReader(std::make_shared<MemoryReader>()),
+    messageIn(Ptr<Functor>(new MemoryReadFunctor(messageReader()))),
+    inDelta(std::make_shared<DeltaReadFunctor>(messageIn())),
+    clock(std::make_shared<NetClock>()) {
+#ifdef SO_NOSIGPIPE
+    sd->setsockopt(SOL_SOCKET, SO_NOSIGPIPE, 1); // No MSG_NOSIGNAL; see writev()
+#endif
+}
 
+Relevance withinRadius(float radius) {
+// Returns a filter that accepts models within 'radius' of the focus model
+    return [=](Model const& focus, Model const& model) {
+        return (model.position()-focus.position()).length() <= radius;
+    };
 }
 
 }
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "jet2/Common.hpp"
+#include "jet2/Interpolator.hpp"
+#include "jet2/Kernel.hpp"
+#include "jet2/NetClock.hpp"
+
+namespace jet2 {
+
+static sfr::Quaternion nlerp(sfr::Quaternion const& a, sfr::Quaternion const& b, float alpha) {
+// Normalized linear interpolation; close enough to slerp for the small angles
+// between consecutive net updates.  Takes the short way around.
+    auto const dot = a.w*b.w+a.x*b.x+a.y*b.y+a.z*b.z;
+    auto const sign = dot < 0 ? -1.f : 1.f;
+    auto const w = a.w+(sign*b.w-a.w)*alpha;
+    auto const x = a.x+(sign*b.x-a.x)*alpha;
+    auto const y = a.y+(sign*b.y-a.y)*alpha;
+    auto const z = a.z+(sign*b.z-a.z)*alpha;
+    auto const len = std::sqrt(w*w+x*x+y*y+z*z);
+    return len > 0 ? sfr::Quaternion(w/len, x/len, y/len, z/len) : a;
+}
+
+void Interpolator::sampleIs(TickId tick, sfr::Vector const& position, sfr::Quaternion const& rotation) {
+// Add the state received for 'tick'.  A later state for the newest tick
+// replaces it; states older than the newest are dropped, since the ring must
+// stay sorted.  When the ring is full, the oldest state is overwritten.
+    if (count_ && tick < at(count_-1).tick) {
+        return;
+    }
+    Sample sample = { tick, position, rotation };
+    if (count_ && tick == at(count_-1).tick) {
+        sample_[(first_+count_-1) % CAPACITY] = sample;
+    } else if (count_ < CAPACITY) {
+        sample_[(first_+count_) % CAPACITY] = sample;
+        ++count_;
+    } else {
+        sample_[first_] = sample;
+        first_ = (first_+1) % CAPACITY;
+    }
+}
+
+bool Interpolator::sample(double tick, sfr::Vector& position, sfr::Quaternion& rotation) const {
+// Interpolate the state at 'tick', which may fall between two ticks.  Before
+// the oldest state or after the newest, the nearest state is used as is.
+// Returns false if there are no states.
+    if (!count_) {
+        return false;
+    }
+    auto after = size_t(0);
+    while (after < count_ && at(after).tick < tick) {
+        ++after;
+    }
+    if (after == 0 || after == count_) {
+        auto const& nearest = at(after ? count_-1 : 0);
+        position = nearest.position;
+        rotation = nearest.rotation;
+        return true;
+    }
+    auto const& a = at(after-1);
+    auto const& b = at(after);
+    auto const alpha = float((tick-a.tick)/double(b.tick-a.tick));
+    position = a.position+(b.position-a.position)*alpha;
+    rotation = nlerp(a.rotation, b.rotation, alpha);
+    return true;
+}
+
+double renderTick() {
+// Take the server's current tick from the server clock, and then step back by
+// interpDelay.  The delay should cover at least one netTimestep, plus jitter,
+// so that there is usually a state on both sides of the render tick.
+    auto const delay = interpDelay.sec()/timestep.sec();
+    auto const now = serverClock ? serverClock->peerTick() : double(tickId);
+    return now-delay;
+}
+
+}
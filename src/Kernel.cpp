@@ -25,6 +25,7 @@
 #include "jet2/Kernel.hpp"
 #include "jet2/Model.hpp"
 #include "jet2/Controller.hpp"
+#include "jet2/NetClock.hpp"
 
 namespace jet2 {
 
@@ -56,15 +57,17 @@ Ptr<coro::Event> const renderEvent(new coro::Event);
 Ptr<Table> const db = std::make_shared<Table>();
 coro::Time const timestep = coro::Time::sec(1./60.);
 coro::Time const netTimestep = coro::Time::millisec(100);
-coro::Time netDelta;
 TickId tickId = 0;
-TickId netTickId = 0;
+NetTime tickTime = 0;
+Ptr<NetClock> serverClock;
+coro::Time interpDelay = coro::Time::millisec(200);
 
 void tick(btDynamicsWorld* world, btScalar timestep) {
 // Run a single collision tick.  Clear forces, notify controllers of any
 // collisions, and then notify any coroutines that are waiting on the tick
 // callback event.
     tickId++;
+    tickTime = NetClock::now();
     world->clearForces();
 
     auto dispatcher = world->getDispatcher();
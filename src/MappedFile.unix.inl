@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace jet2 {
+
+MappedFile::MappedFile(std::string const& path, bool writable) : path_(path), writable_(writable) {
+// Open the file.  A writable file is created (or truncated); a read-only file
+// is mapped in full.
+    auto const flags = writable ? (O_RDWR|O_CREAT|O_TRUNC) : O_RDONLY;
+    fd_ = open(path.c_str(), flags, 0644);
+    if (fd_ < 0) {
+        throw ResourceException("failed to open file: "+path);
+    }
+    if (!writable) {
+        struct stat st;
+        if (fstat(fd_, &st) != 0) {
+            close(fd_);
+            throw ResourceException("failed to stat file: "+path);
+        }
+        size_ = size_t(st.st_size);
+        map(size_);
+    }
+}
+
+MappedFile::~MappedFile() {
+    unmap();
+    if (writable_ && ftruncate(fd_, off_t(size_)) != 0) {
+        std::cerr << "warning: failed to truncate " << path_ << std::endl;
+    }
+    close(fd_);
+}
+
+void MappedFile::map(size_t capacity) {
+    if (writable_ && ftruncate(fd_, off_t(capacity)) != 0) {
+        throw ResourceException("failed to grow file: "+path_);
+    }
+    capacity_ = capacity;
+    if (!capacity) {
+        return; // Can't map an empty file
+    }
+    auto const prot = writable_ ? (PROT_READ|PROT_WRITE) : PROT_READ;
+    auto data = mmap(0, capacity, prot, MAP_SHARED, fd_, 0);
+    if (data == MAP_FAILED) {
+        throw ResourceException("failed to map file: "+path_);
+    }
+    data_ = (char*)data;
+}
+
+void MappedFile::unmap() {
+    if (data_) {
+        munmap(data_, capacity_);
+        data_ = nullptr;
+    }
+}
+
+}
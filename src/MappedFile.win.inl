@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <windows.h>
+
+namespace jet2 {
+
+MappedFile::MappedFile(std::string const& path, bool writable) : path_(path), writable_(writable) {
+// Open the file.  A writable file is created (or truncated); a read-only file
+// is mapped in full.
+    auto const access = writable ? (GENERIC_READ|GENERIC_WRITE) : GENERIC_READ;
+    auto const disposition = writable ? CREATE_ALWAYS : OPEN_EXISTING;
+    file_ = CreateFileA(path.c_str(), access, FILE_SHARE_READ, 0, disposition, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file_ == INVALID_HANDLE_VALUE) {
+        throw ResourceException("failed to open file: "+path);
+    }
+    if (!writable) {
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file_, &size)) {
+            CloseHandle(file_);
+            throw ResourceException("failed to stat file: "+path);
+        }
+        size_ = size_t(size.QuadPart);
+        map(size_);
+    }
+}
+
+MappedFile::~MappedFile() {
+    unmap();
+    if (writable_) {
+        LARGE_INTEGER size;
+        size.QuadPart = LONGLONG(size_);
+        if (!SetFilePointerEx(file_, size, 0, FILE_BEGIN) || !SetEndOfFile(file_)) {
+            std::cerr << "warning: failed to truncate " << path_ << std::endl;
+        }
+    }
+    CloseHandle(file_);
+}
+
+void MappedFile::map(size_t capacity) {
+// Creating a mapping larger than the file grows the file
+    capacity_ = capacity;
+    if (!capacity) {
+        return; // Can't map an empty file
+    }
+    auto const protect = writable_ ? PAGE_READWRITE : PAGE_READONLY;
+    auto const high = DWORD(uint64_t(capacity) >> 32);
+    auto const low = DWORD(uint64_t(capacity) & 0xffffffff);
+    mapping_ = CreateFileMappingA(file_, 0, protect, high, low, 0);
+    if (!mapping_) {
+        throw ResourceException("failed to map file: "+path_);
+    }
+    auto const access = writable_ ? FILE_MAP_WRITE : FILE_MAP_READ;
+    data_ = (char*)MapViewOfFile(mapping_, access, 0, 0, capacity);
+    if (!data_) {
+        throw ResourceException("failed to map file: "+path_);
+    }
+}
+
+void MappedFile::unmap() {
+    if (data_) {
+        UnmapViewOfFile(data_);
+        data_ = nullptr;
+    }
+    if (mapping_) {
+        CloseHandle(mapping_);
+        mapping_ = nullptr;
+    }
+}
+
+}
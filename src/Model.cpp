@@ -23,7 +23,251 @@
 #include "jet2/Common.hpp"
 #include "jet2/Model.hpp"
 #include "jet2/Object.hpp"
+#include "jet2/Functor.hpp"
+#include "jet2/Snapshot.hpp"
+#include "jet2/Table.hpp"
+#include "jet2/WorkerPool.hpp"
 
 namespace jet2 {
 
+void dirtyIs(Model* model) {
+    model->dirtyIs();
+}
+
+void Model::tableIs(ModelTable* table) {
+// Register the model with a model table.  Serialized attrs are bound to the
+// model, so that writes to them mark the model dirty in the table.
+    table_ = table;
+    visit(std::make_shared<BindFunctor>(this));
+}
+
+Ptr<Snapshot const> Model::snapshot() {
+// Returns the encoded state of the model.  If the model is registered, the
+// encoding is shared with every connection until the model is marked dirty.
+    if (table_) {
+        return table_->snapshot(this);
+    }
+    auto snapshot = std::make_shared<Snapshot>();
+    visit(snapshot);
+    return snapshot;
+}
+
+void DirtySet::modelIs(ModelId id) {
+// Add a model to the set, if it isn't already queued.  If the model's slot
+// is queued for a deleted model, the new model is queued as well; the
+// deleted model's id no longer resolves, so it's skipped when drained.
+    auto const index = modelIndex(id);
+    if (index >= queued_.size()) {
+        queued_.resize(index+1);
+    }
+    if (queued_[index] != id) {
+        queued_[index] = id;
+        model_.push_back(id);
+    }
+}
+
+void DirtySet::modelDel(ModelId id) {
+// Record that a model was deleted, so that the peer can delete it too
+    deleted_.push_back(id);
+}
+
+std::vector<ModelId> const& DirtySet::drain() {
+// Remove all models from the set, and return them.  Models that are marked
+// dirty while the caller is processing the result go into the next drain.
+    drained_.clear();
+    drained_.swap(model_);
+    for (auto id : drained_) {
+        queued_[modelIndex(id)] = 0;
+    }
+    return drained_;
+}
+
+std::vector<ModelId> DirtySet::drainDeleted() {
+// Remove and return the models deleted since the last call, in the order
+// they were deleted, so that each REMOVE is sent before the CONSTRUCT of a
+// model that reuses the slot.
+    auto deleted = std::vector<ModelId>();
+    deleted.swap(deleted_);
+    return deleted;
+}
+
+ModelTable::~ModelTable() {
+    for (auto model : model_) {
+        if (model) {
+            model->table_ = nullptr;
+        }
+    }
+}
+
+Ptr<Model> ModelTable::model(ModelId id) const {
+// Returns the model with the given id, or null if the id was never assigned
+// or belongs to a model that was deleted.
+    auto const index = modelIndex(id);
+    if (index >= model_.size() || !model_[index] || model_[index]->id() != id) {
+        return 0;
+    }
+    return model_[index];
+}
+
+void ModelTable::modelIs(Ptr<Model> model, Table* table, std::string const& name) {
+// Add a model to the registry, and assign it an ID if it doesn't already have
+// one: the most recently freed slot, or else a new slot.  If 'table' is set,
+// the model is deleted from it by objectDel().  The model is marked dirty, so
+// that it is sent in the next frame.
+    if (model->id() == 0) {
+        auto index = uint32_t(model_.size() ? model_.size() : 1);
+        if (!free_.empty()) {
+            index = free_.back();
+            free_.pop_back();
+        }
+        assert(index < (1u << MODEL_INDEX_BITS));
+        model->id = modelId(index, index < generation_.size() ? generation_[index] : 0);
+    }
+    auto const index = modelIndex(model->id());
+    if (index >= model_.size()) {
+        model_.resize(index+1);
+        generation_.resize(index+1);
+        owner_.resize(index+1);
+    }
+    if (!model_[index]) {
+        ++live_;
+    }
+    model_[index] = model;
+    generation_[index] = modelGeneration(model->id());
+    owner_[index].table = table;
+    owner_[index].name = name;
+    model->tableIs(this);
+    dirtyIs(model.get());
+}
+
+void ModelTable::modelDel(ModelId id) {
+// Remove a model from the registry.  The model is no longer replicated.  If
+// the model is an output, connections tell their peers to delete their
+// copies.  The slot is freed for reuse with the next generation.
+    auto model = this->model(id);
+    if (!model) {
+        return;
+    }
+    auto const index = modelIndex(id);
+    model->table_ = nullptr;
+    model_[index].reset();
+    owner_[index] = Owner();
+    if (index < snapshot_.size()) {
+        snapshot_[index].reset();
+    }
+    generation_[index] = (generation_[index]+1) % MODEL_GENERATIONS;
+    free_.push_back(index);
+    --live_;
+    if (model->netMode() != Model::OUTPUT) {
+        return;
+    }
+    for (auto i = dirtySet_.begin(); i != dirtySet_.end();) {
+        if (auto set = i->lock()) {
+            set->modelDel(id);
+            ++i;
+        } else {
+            i = dirtySet_.erase(i);
+        }
+    }
+}
+
+void ModelTable::objectDel(ModelId id) {
+// Delete a model from the table that holds it, which also removes it from the
+// registry.  Used to apply a REMOVE from the peer.
+    auto const model = this->model(id);
+    if (!model) {
+        return;
+    }
+    auto const owner = owner_[modelIndex(id)];
+    if (owner.table) {
+        owner.table->objectDel(owner.name);
+    }
+    modelDel(id); // In case the table didn't hold it
+}
+
+std::string ModelTable::path(ModelId id) const {
+// Returns the path the model was created at, relative to the replicated
+// table, which is what the peer binds the model's id to.  Without a root,
+// the path is from the table's own root.
+    if (!model(id)) {
+        return std::string(); // Also out of range
+    }
+    auto const& owner = owner_[modelIndex(id)];
+    if (!owner.table) {
+        return std::string();
+    }
+    auto const root = root_ ? root_->path().size() : 0;
+    return owner.table->path().substr(root)+owner.name;
+}
+
+void ModelTable::dirtyIs(Model* model) {
+// Mark a model dirty in every dirty set subscribed to the table
+    if (model->id() == 0) {
+        return;
+    }
+    auto const index = modelIndex(model->id());
+    if (index < snapshot_.size()) {
+        snapshot_[index].reset();
+    }
+    for (auto i = dirtySet_.begin(); i != dirtySet_.end();) {
+        if (auto set = i->lock()) {
+            set->modelIs(model->id());
+            ++i;
+        } else {
+            i = dirtySet_.erase(i);
+        }
+    }
+}
+
+Ptr<Snapshot const> ModelTable::snapshot(Model* model) {
+// Returns the model's encoded state, encoding it only if it changed since the
+// last call.  Snapshots are immutable once returned, so connections may keep
+// them as delta baselines; the cache drops its reference when the model is
+// marked dirty, and the snapshot lives on while any connection holds it.
+// The cache is keyed on changes, not time, so that snapshots encoded on the
+// pool stay valid until the frame is sent, however many ticks pass; code that
+// changes a field without a bound Attr must call dirtyIs() (see Model).
+    auto const index = modelIndex(model->id());
+    if (index >= snapshot_.size()) {
+        snapshot_.resize(index+1);
+    }
+    if (!snapshot_[index]) {
+        auto snapshot = std::make_shared<Snapshot>();
+        model->visit(snapshot);
+        snapshot_[index] = snapshot;
+    }
+    return snapshot_[index];
+}
+
+void ModelTable::snapshotIs(std::vector<ModelId> const& ids, WorkerPool& pool) {
+// Encode the given models on the pool, so that sending them later only
+// copies the cached snapshots.  The models must not change until this
+// returns.  Each task writes only its own model's cache slot.  Encoding only
+// reads the models: attrs are bound when a model is registered, not by a
+// Snapshot, and a functor stores a field only if it changed the field's
+// bytes, which a Snapshot never does.  Thus, models may share nested objects,
+// but a model's visit() must not have side effects of its own.
+    snapshot_.resize(std::max(snapshot_.size(), model_.size()));
+    pool.run(ids.size(), [&](size_t i) {
+        auto const index = modelIndex(ids[i]);
+        auto model = this->model(ids[i]);
+        if (model && !snapshot_[index]) {
+            auto snapshot = std::make_shared<Snapshot>();
+            model->visit(snapshot);
+            snapshot_[index] = snapshot;
+        }
+    });
+}
+
+void ModelTable::dirtySetIs(Ptr<DirtySet> set) {
+// Subscribe a dirty set to the table.  All models are initially dirty, so
+// that the first frame contains the full state.
+    dirtySet_.push_back(set);
+    for (auto model : model_) {
+        if (model) {
+            set->modelIs(model->id());
+        }
+    }
+}
+
 }
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "jet2/Common.hpp"
+#include "jet2/NetClock.hpp"
+#include "jet2/Kernel.hpp"
+#include <chrono>
+
+namespace jet2 {
+
+static double const RTT_GAIN = 1./8.; // As for TCP's smoothed RTT
+static double const JITTER_GAIN = 1./16.; // As for RTP's interarrival jitter
+
+NetClock::NetClock() {
+    lastSent_ = now();
+}
+
+NetTime NetClock::now() {
+// Returns the local monotonic time, in microseconds
+    auto const elapsed = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+void NetClock::sendIs(NetTime& sent, NetTime& echo, uint32_t& hold, uint32_t& phase, NetTime time) {
+// Fill in the timestamps for a frame sent at 'time'
+    sent = time;
+    echo = peerSent_;
+    hold = peerSent_ ? uint32_t(sent-peerRecv_) : 0;
+    phase = uint32_t(std::max(sent-tickTime, NetTime(0)));
+    lastSent_ = sent;
+}
+
+void NetClock::recvIs(TickId tick, NetTime sent, NetTime echo, uint32_t hold, uint32_t phase, NetTime time) {
+// Update the estimates from the timestamps of a frame received at 'time'.
+// The frame was sent halfway through the round trip, so its send time and
+// tick correspond to 'time' less half the RTT.  Before the first RTT sample, the
+// RTT is taken to be zero.
+    peerSent_ = sent;
+    peerRecv_ = time;
+    auto const tickLen = double(timestep.microsec());
+    if (echo) {
+        auto const sample = double(time-echo-NetTime(hold));
+        if (sample >= 0) {
+            if (!samples_) {
+                rtt_ = sample;
+            } else {
+                jitter_ += (std::abs(sample-rtt_)-jitter_)*JITTER_GAIN;
+                rtt_ += (sample-rtt_)*RTT_GAIN;
+            }
+            ++samples_;
+        }
+    }
+    auto const local = double(time)-rtt_/2; // When the frame was sent, on our clock
+    auto const offset = double(sent)-local;
+    auto const base = double(tick)+double(phase)/tickLen-local/tickLen;
+    if (samples_ <= 1) {
+        offset_ = offset; // Replace the estimate made without an RTT
+        tickBase_ = base;
+    } else {
+        offset_ += (offset-offset_)*RTT_GAIN;
+        tickBase_ += (base-tickBase_)*RTT_GAIN;
+    }
+}
+
+double NetClock::peerTick(NetTime time) const {
+// Map a local time to the peer's (fractional) tick.  Both sides tick once
+// per timestep, so the mapping is linear.
+    return tickBase_+double(time)/double(timestep.microsec());
+}
+
+}
@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "jet2/Common.hpp"
+#include "jet2/NetSim.hpp"
+#include "jet2/NetClock.hpp"
+
+#define log(msg) std::cerr << msg << std::endl;
+
+namespace jet2 {
+
+size_t const SEGMENT_SIZE = 1460; // Stream data is delayed and lost per TCP segment
+size_t const MAX_DATAGRAM = 65536;
+size_t const MAX_QUEUED = 4 << 20; // Buffered by a link with unlimited bandwidth
+NetTime const MIN_RTO = 200000; // Linux's minimum retransmission timeout
+
+class NetPipe {
+// One direction of a simulated link.  Packets read from 'in' are queued in
+// delivery order, and written to 'out' when they are due.
+public:
+    struct Packet {
+        NetTime deliver;
+        std::vector<char> data;
+    };
+
+    Ptr<coro::Socket> in;
+    Ptr<coro::Socket> out;
+    bool stream = true;
+    std::deque<Packet> queue;
+    size_t queued = 0; // Bytes in 'queue'
+    coro::Event event;
+    NetTime linkFree = 0; // When the link finishes sending the last packet queued
+    NetTime last = 0; // Delivery time of the last packet queued
+    bool closed = false; // Input closed, or output failed
+    Ptr<coro::Coroutine> reader;
+    Ptr<coro::Coroutine> writer;
+};
+
+NetTime NetSim::deliver(NetPipe& pipe, size_t len) {
+// Returns when the link delivers a packet of 'len' bytes sent now, or -1 if
+// the packet is lost.  The packet waits for the packets ahead of it to be
+// sent at the link's bandwidth, and then arrives after the link's latency.
+    if (!seeded_) {
+        random_.seed(seed());
+        seeded_ = true;
+    }
+    auto const& cond = condition();
+    auto uniform = std::uniform_real_distribution<double>(0, 1);
+    auto const latency = double(cond.latency.microsec());
+    auto const jitter = double(cond.jitter.microsec());
+    auto delay = latency+jitter*(2*uniform(random_)-1);
+    if (uniform(random_) < cond.loss) {
+        if (!pipe.stream) {
+            dropped = dropped()+1;
+            return -1;
+        }
+        delay += std::max(double(MIN_RTO), 2*latency); // Retransmitted
+    }
+    if (!pipe.stream && uniform(random_) < cond.reorder) {
+        delay += latency+jitter+1000; // Arrives after datagrams sent later
+    }
+    auto sent = NetClock::now();
+    if (cond.bandwidth > 0) {
+        sent = std::max(sent, pipe.linkFree)+NetTime(double(len)*1e6/cond.bandwidth);
+        pipe.linkFree = sent;
+    }
+    auto time = sent+NetTime(std::max(delay, 0.));
+    if (pipe.stream) {
+        time = std::max(time, pipe.last); // In order
+    }
+    pipe.last = time;
+    packets = packets()+1;
+    bytes = bytes()+len;
+    return time;
+}
+
+size_t NetSim::budget(NetPipe const& pipe) {
+// Returns how many bytes 'pipe' may hold in flight and waiting for the link:
+// one bandwidth-delay product, but at least one packet.
+    auto const& cond = condition();
+    auto const packet = pipe.stream ? SEGMENT_SIZE : MAX_DATAGRAM;
+    if (cond.bandwidth <= 0) {
+        return MAX_QUEUED;
+    }
+    auto const delay = double(cond.latency.microsec()+cond.jitter.microsec());
+    return std::max(packet, size_t(cond.bandwidth*delay/1e6));
+}
+
+static void read(WeakPtr<NetSim> sim, Ptr<NetPipe> pipe) {
+// Read packets from the pipe's input, and queue each one to be written when
+// the simulated link would deliver it.  A stream stops reading while the link
+// is over budget, so that the sender's writes block as they would on a real
+// link; a datagram that arrives over budget is dropped.
+    auto buf = std::vector<char>(pipe->stream ? SEGMENT_SIZE : MAX_DATAGRAM);
+    try {
+        for (;;) {
+            if (pipe->stream) {
+                for (auto self = sim.lock(); self && !pipe->closed && pipe->queued > self->budget(*pipe); self = sim.lock()) {
+                    self.reset();
+                    pipe->event.wait();
+                }
+            }
+            auto len = pipe->in->read(&buf.front(), buf.size());
+            auto self = sim.lock();
+            if (len <= 0 || !self || pipe->closed) {
+                break;
+            }
+            if (!pipe->stream && pipe->queued+len > self->budget(*pipe)) {
+                self->dropped = self->dropped()+1;
+                continue;
+            }
+            auto const time = self->deliver(*pipe, len);
+            if (time < 0) {
+                continue; // Lost
+            }
+            NetPipe::Packet packet = { time, std::vector<char>(buf.begin(), buf.begin()+len) };
+            auto& queue = pipe->queue;
+            auto pos = std::upper_bound(queue.begin(), queue.end(), time, [](NetTime time, NetPipe::Packet const& packet) {
+                return time < packet.deliver;
+            });
+            queue.insert(pos, std::move(packet));
+            pipe->queued += len;
+            pipe->event.notifyAll();
+        }
+    } catch (coro::SystemError const&) {
+    }
+    pipe->closed = true;
+    pipe->event.notifyAll();
+}
+
+static void write(Ptr<NetPipe> pipe) {
+// Write each queued packet to the pipe's output when it is due.  When a
+// stream's input closes, the output is shut down once the queue drains, so
+// that the peer sees the close after the data.
+    try {
+        for (;;) {
+            auto& queue = pipe->queue;
+            if (queue.empty()) {
+                if (pipe->closed) {
+                    break;
+                }
+                pipe->event.wait();
+                continue;
+            }
+            auto const wait = queue.front().deliver-NetClock::now();
+            if (wait > 0) {
+                coro::sleep(coro::Time::microsec(wait));
+                continue; // An earlier packet may have been queued meanwhile
+            }
+            auto packet = std::move(queue.front());
+            queue.pop_front();
+            pipe->queued -= packet.data.size();
+            pipe->event.notifyAll(); // The reader may be waiting for room
+            if (pipe->stream) {
+                pipe->out->writeAll(&packet.data.front(), packet.data.size());
+            } else {
+                pipe->out->write(&packet.data.front(), packet.data.size());
+            }
+        }
+        if (pipe->stream) {
+            pipe->out->shutdown(SHUT_WR);
+        }
+    } catch (coro::SystemError const&) {
+        pipe->closed = true; // Stop the reader waiting for room
+        pipe->event.notifyAll();
+    }
+}
+
+NetSim::~NetSim() {
+    if (listener()) {
+        listener()->close();
+    }
+    for (auto pipe : pipe_) {
+        pipe->in->close();
+        pipe->event.notifyAll();
+    }
+}
+
+void NetSim::pipeIs(Ptr<coro::Socket> in, Ptr<coro::Socket> out, bool stream) {
+// Forward packets from 'in' to 'out' through the simulated link
+    auto pipe = std::make_shared<NetPipe>();
+    auto weak = WeakPtr<NetSim>(std::static_pointer_cast<NetSim>(shared_from_this()));
+    pipe->in = in;
+    pipe->out = out;
+    pipe->stream = stream;
+    pipe->reader = coro::start([=]{ read(weak, pipe); });
+    pipe->writer = coro::start([=]{ write(pipe); });
+    pipe_.push_back(pipe);
+}
+
+void NetSim::profileIs(NetProfile const& profile) {
+// Change the link's conditions at each step of 'profile', timed from now
+    auto weak = WeakPtr<NetSim>(std::static_pointer_cast<NetSim>(shared_from_this()));
+    auto const start = NetClock::now();
+    script = coro::start([=]{
+        for (auto const& step : profile) {
+            auto const wait = start+step.at.microsec()-NetClock::now();
+            if (wait > 0) {
+                coro::sleep(coro::Time::microsec(wait));
+            }
+            auto self = weak.lock();
+            if (!self) {
+                return; // Sim died
+            }
+            self->condition = step.condition;
+        }
+    });
+}
+
+Ptr<NetSim> streamSim(uint16_t port, uint16_t target) {
+// Accept TCP connections on 'port', and connect each one through a simulated
+// link to 'target'.
+    auto sim = std::make_shared<NetSim>();
+    auto weak = WeakPtr<NetSim>(sim);
+    auto ls = std::make_shared<coro::Socket>();
+    ls->setsockopt(SOL_SOCKET, SO_REUSEADDR, 1);
+    ls->bind(coro::SocketAddr("127.0.0.1", port));
+    ls->listen(16);
+    sim->listener = ls;
+    sim->accept = coro::start([=]{
+        try {
+            for (;;) {
+                auto in = ls->accept();
+                auto self = weak.lock();
+                if (!self) {
+                    return; // Sim died
+                }
+                auto out = std::make_shared<coro::Socket>();
+                out->connect(coro::SocketAddr("127.0.0.1", target));
+                in->setsockopt(IPPROTO_TCP, TCP_NODELAY, true);
+                out->setsockopt(IPPROTO_TCP, TCP_NODELAY, true);
+                self->pipeIs(in, out, true);
+                self->pipeIs(out, in, true);
+            }
+        } catch (coro::SystemError const& ex) {
+            log("error: sim: " << ex.what());
+        }
+    });
+    return sim;
+}
+
+Ptr<NetSim> datagramSim(uint16_t portA, uint16_t peerA, uint16_t portB, uint16_t peerB) {
+// Relay datagrams through a simulated link.  Endpoint A (at 'peerA') sends to
+// 'portA', and endpoint B (at 'peerB') sends to 'portB'; each side receives
+// the other's datagrams from the sim's port.
+    auto sim = std::make_shared<NetSim>();
+    auto a = std::make_shared<coro::Socket>(SOCK_DGRAM);
+    auto b = std::make_shared<coro::Socket>(SOCK_DGRAM);
+    a->setsockopt(SOL_SOCKET, SO_REUSEADDR, 1);
+    b->setsockopt(SOL_SOCKET, SO_REUSEADDR, 1);
+    a->bind(coro::SocketAddr("127.0.0.1", portA));
+    b->bind(coro::SocketAddr("127.0.0.1", portB));
+    a->connect(coro::SocketAddr("127.0.0.1", peerA));
+    b->connect(coro::SocketAddr("127.0.0.1", peerB));
+    sim->pipeIs(a, b, false);
+    sim->pipeIs(b, a, false);
+    return sim;
+}
+
+}
@@ -26,32 +26,34 @@
 #include "jet2/Connection.hpp"
 #include "jet2/Model.hpp"
 #include "jet2/Controller.hpp"
+#include "jet2/Interpolator.hpp"
+#include "jet2/Recorder.hpp"
 
 #undef assert
 #define assert(x) if (!(x)) { __debugbreak(); }
 
 namespace jet2 {
 
-void assignId(Ptr<ModelTable> mt, Ptr<Model> model, std::string const& name) {
-// Assign an ID to the given model, if not already assigned, and add it to the
-// model lookup table.
-     if (model->id() == 0) {
-         mt->nextId = mt->nextId()+1;
-         model->id = mt->nextId;
-     }
-     std::cout << name << " => " << model->id() << std::endl;
-     mt->model(model->id(), model);
-}
+struct Registration {
+    std::string path; // Relative to the replicated table
+    Ptr<Table> table;
+    std::string name;
+    Ptr<Model> model;
+};
 
-void assignIds(Ptr<ModelTable> mt, Ptr<Table> db) {
-// Assign IDs recursively to all models in the database.
-    for (auto entry : *db) {
+void collectModels(Ptr<ModelTable> mt, Ptr<Table> db, size_t root, std::vector<Registration>& out) {
+// Find the models that already exist in the database, and attach the registry
+// to every table, so that models created from now on are assigned an id as
+// soon as Table::objectIs() creates them.  'root' is the length of the
+// replicated table's path, which is stripped from each model's path.
+    db->registryIs(mt);
+    for (auto& entry : *db) {
         if (entry.second.cast<Object>() == mt) {
             // Pass
-        } else if (auto db = entry.second.cast<Table>()) {
-            assignIds(mt, db);
-        } else if(auto model = entry.second.cast<Model>()) {
-            assignId(mt, model, entry.first);
+        } else if (auto table = entry.second.cast<Table>()) {
+            collectModels(mt, table, root, out);
+        } else if (auto model = entry.second.cast<Model>()) {
+            out.push_back(Registration{db->path().substr(root)+entry.first, db, entry.first, model});
         } else {
             assert(!"not a model");
         }
@@ -59,65 +61,639 @@ void assignIds(Ptr<ModelTable> mt, Ptr<Table> db) {
 }
 
 Ptr<ModelTable> modelTable(Ptr<Table> db) {
-// Create the model/model ID mapping.  The mapping must be identical for both
-// sides of the connection.
+// Create the model/model ID mapping.  IDs are local: the peer binds each ID
+// to its own model at the same path relative to 'db' when CONSTRUCT arrives,
+// so the mapping doesn't have to match the peer's, and 'db' may be mounted
+// at a different place on each side (e.g., "models/" on the server and
+// "remotes/" on the client).  Models that already exist are assigned IDs in
+// order of their paths, so that runs are reproducible; models created later
+// are assigned IDs by the table as they are created, and the peer creates
+// its copies when they arrive if Connection::spawn is set.  Deleted models
+// free their slots for reuse with a new generation; deleting an output model
+// sends REMOVE, so the peer deletes its copy.
     auto mt = db->object<ModelTable>("mt");
     if (mt) { 
         return mt; 
     }
     mt = db->objectIs<ModelTable>("mt");
-    assignIds(mt, db);
+    mt->rootIs(db.get());
+    auto models = std::vector<Registration>();
+    collectModels(mt, db, db->path().size(), models);
+    std::sort(models.begin(), models.end(), [](Registration const& a, Registration const& b) {
+        return a.path < b.path;
+    });
+    for (auto const& entry : models) {
+        mt->modelIs(entry.model, entry.table.get(), entry.name);
+    }
     return mt;
 }
 
-void sendMessage(Ptr<Connection> conn, Ptr<Model> model) {
-// Send a single message for a single model.  Ensure that if another coroutine
-// is currently sending a message, the call is blocked until the message is
-// atomically sent, to avoid interleaving messages non-atomically.
-    if (model->id() == 0 || model->syncMode() == Model::DISABLED || model->netMode() == Model::INPUT) { 
-        return;
-    }
+void acquire(Ptr<Connection> conn) {
+// Wait until no other coroutine is sending on the connection, and then claim
+// it, so that frames are never interleaved.
     while (conn->state() == Connection::SENDING) {
         conn->event.wait();
     }
     conn->state = Connection::SENDING;
-    conn->out()->val(model->id());
+}
+
+void release(Ptr<Connection> conn) {
+    conn->state = Connection::IDLE;
+    conn->event.notifyAll();
+}
+
+void beginFrame(Ptr<Connection> conn) {
+// Start a frame.  The header is reserved in the writer, and filled in by
+// endFrame() once the message count and length are known.
+    conn->frameOffset = conn->writer()->reserve(FRAME_HEADER_SIZE);
+    conn->frameStart = conn->writer()->bytes();
+    conn->frameMessages = 0;
+}
+
+bool recording(Ptr<Connection> conn) {
+// Returns true if the connection has a recorder that has logged every frame
+// so far.  A log that starts mid-connection can't be replayed, since frames
+// depend on the ones before them (CONSTRUCT, delta baselines); thus, a
+// recorder attached after the first frame is detached.
+    auto recorder = conn->recorder();
+    if (!recorder) {
+        return false;
+    } else if (recorder->frames() != conn->frames()) {
+        std::cerr << "error: recorder attached after the first frame" << std::endl;
+        conn->recorder = Ptr<Recorder>();
+        return false;
+    }
+    return true;
+}
+
+TickId tickSimulated(Ptr<Connection> conn) {
+// Returns the last of the peer's ticks whose input the local simulation has
+// stepped, which is echoed to the peer as 'ack'.  The simulation runs at the
+// start of each tick, so frames applied since then are stepped only in the
+// next tick, and the state sent now doesn't include them yet.
+    return conn->tickInAt() == jet2::tickId ? conn->tickInBefore() : conn->tickIn();
+}
+
+void endFrame(Ptr<Connection> conn) {
+// Fill in the frame header, or remove it if the frame is empty.  An empty
+// frame is still sent if the peer hasn't had one for NetClock::INTERVAL, so
+// that both clocks keep getting samples; its body is empty even if
+// compression is on.
+    auto const writer = conn->writer();
+    if (!conn->frameMessages() && !conn->clock()->due()) {
+        writer->reservedDel(conn->frameOffset(), FRAME_HEADER_SIZE);
+        return;
+    }
+    auto const record = recording(conn);
+    auto& raw = conn->frameRaw;
+    raw.clear();
+    if (conn->compress() || record) {
+        writer->tail(conn->frameOffset()+FRAME_HEADER_SIZE, raw);
+    }
+    if (conn->compress() && conn->frameMessages()) {
+        auto& compressed = conn->frameCompressed;
+        auto const rawLen = FrameLen(raw.size());
+        compressed.resize(sizeof(rawLen));
+        memcpy(&compressed.front(), &rawLen, sizeof(rawLen));
+        conn->compressor.compress(raw.data(), raw.size(), compressed);
+        writer->write(&compressed.front(), compressed.size());
+    } else if (!raw.empty()) {
+        writer->write(raw.data(), raw.size()); // Copied out only to record it
+    }
+    auto const tick = jet2::tickId;
+    auto const ack = tickSimulated(conn);
+    auto const messages = conn->frameMessages();
+    auto const len = FrameLen(writer->bytes()-conn->frameStart());
+    assert(len <= MAX_FRAME_SIZE && raw.size() <= MAX_FRAME_SIZE && "frame too large for the peer");
+    auto sent = NetTime(0);
+    auto echo = NetTime(0);
+    auto hold = uint32_t(0);
+    auto phase = uint32_t(0);
+    conn->clock()->sendIs(sent, echo, hold, phase);
+    char header[FRAME_HEADER_SIZE];
+    auto ptr = header;
+    memcpy(ptr, &tick, sizeof(tick)); ptr += sizeof(tick);
+    memcpy(ptr, &ack, sizeof(ack)); ptr += sizeof(ack);
+    memcpy(ptr, &sent, sizeof(sent)); ptr += sizeof(sent);
+    memcpy(ptr, &echo, sizeof(echo)); ptr += sizeof(echo);
+    memcpy(ptr, &hold, sizeof(hold)); ptr += sizeof(hold);
+    memcpy(ptr, &phase, sizeof(phase)); ptr += sizeof(phase);
+    memcpy(ptr, &messages, sizeof(messages)); ptr += sizeof(messages);
+    memcpy(ptr, &len, sizeof(len));
+    writer->reservedIs(conn->frameOffset(), header, sizeof(header));
+    if (record) {
+        conn->recorder()->frameIs(Recorder::OUT, tick, ack, messages, raw.data(), raw.size());
+    }
+    conn->frames = conn->frames()+1;
+}
+
+void beginMessage(Ptr<Connection> conn, ModelId id, uint8_t flags) {
+// Start a message.  The message is built in memory until endMessage(), so
+// that it can be prefixed with its length.  The model id and flags are sent
+// as one varint, so a message for one of the first 16 models has a one-byte
+// header.
+    assert(flags < (1 << MESSAGE_FLAG_BITS));
+    auto tag = (uint64_t(id) << MESSAGE_FLAG_BITS) | flags;
+    conn->messageWriter()->clear();
+    conn->messageOut()->valVarint(tag);
+}
+
+void endMessage(Ptr<Connection> conn, Ptr<Snapshot const> payload=Ptr<Snapshot const>()) {
+// Send the message built since beginMessage(), prefixed with its length and
+// followed by 'payload'.  The payload is shared, so it's sent without a copy.
+    auto message = conn->messageWriter();
+    auto len = MessageLen(message->size()+(payload ? payload->size() : 0));
+    conn->out()->valVarint(len);
+    conn->writer()->write((char*)message->data(), message->size());
+    if (payload) {
+        conn->writer()->segmentIs(payload, payload->data(), payload->size());
+    }
+    conn->frameMessages = conn->frameMessages()+1;
+}
+
+Ptr<Schema const> peerSchema(Ptr<Connection> conn, Model& model) {
+// Returns the peer's schema for the model's type, or null if the peer encodes
+// the type the same way.  A type the peer hasn't described is treated as
+// encoded differently, with no fields in common: it isn't sent as a delta,
+// and nothing is decoded from the peer's messages for it.  The result is
+// cached by type, so that most messages cost one lookup.
+    if (!conn->schemas()) {
+        return Ptr<Schema const>(); // No handshake, e.g., in a replay
+    }
+    auto const type = std::type_index(typeid(model));
+    auto entry = conn->peerSchemaByType.find(type);
+    if (entry != conn->peerSchemaByType.end()) {
+        return entry->second;
+    }
+    auto local = schema(model);
+    auto peer = conn->peerSchema(local->type());
+    if (!peer) {
+        auto unknown = std::make_shared<Schema>();
+        unknown->type = local->type();
+        peer = unknown;
+    } else if (peer->hash() == local->hash()) {
+        peer.reset();
+    }
+    conn->peerSchemaByType[type] = peer;
+    return peer;
+}
+
+void sendSchemas(Ptr<Connection> conn, Ptr<Table> db) {
+// Describe the model types in the database to the peer, as part of the
+// handshake.  Both the types sent and the types received are described, so
+// that each side knows which types the other encodes differently.
+    auto list = schemaList(db);
+    conn->out()->val(list);
+    for (auto schema : list->schema) {
+        conn->schemaOut(schema->type(), true);
+    }
+}
+
+void recvSchemas(Ptr<Connection> conn) {
+// Read the peer's schemas, as sent by sendSchemas()
+    auto list = std::make_shared<SchemaList>();
+    conn->in()->val(list);
+    for (auto schema : list->schema) {
+        conn->peerSchema(schema->type(), schema);
+    }
+    conn->peerSchemaByType.clear();
+    conn->schemas = true;
+}
+
+void sendSchema(Ptr<Connection> conn, Ptr<Schema const> schema) {
+// Describe a model type that the handshake didn't, as a SCHEMA message in
+// the current frame.  Each type is described once per connection.
+    if (!conn->schemas() || conn->schemaOut(schema->type())) {
+        return;
+    }
+    beginMessage(conn, 0, jet2::Model::SCHEMA);
+    std::const_pointer_cast<Schema>(schema)->visit(conn->messageOut()); // Unchanged by writing
+    endMessage(conn);
+    conn->schemaOut(schema->type(), true);
+}
+
+void schemaReplyIs(Ptr<Connection> conn, Ptr<Schema const> schema) {
+// Describe the type in the next frame, if it hasn't been described yet.  The
+// peer's first message for a type is a CONSTRUCT, so that's when the reply
+// is queued.
+    auto& reply = conn->schemaReply;
+    if (!conn->schemaOut(schema->type()) && std::find(reply.begin(), reply.end(), schema) == reply.end()) {
+        reply.push_back(schema);
+    }
+}
+
+void recvSchema(Ptr<Connection> conn) {
+// Read a model type described by sendSchema()
+    auto schema = std::make_shared<Schema>();
+    schema->visit(conn->messageIn());
+    conn->peerSchema(schema->type(), schema);
+    conn->peerSchemaByType.clear();
+}
+
+void decode(Ptr<Functor> in, Ptr<Schema const> peer, Model& model, bool construct) {
+// Decode the model's construct() or visit() fields from a full message.  If
+// the peer encodes the type differently, the fields are matched by schema.
+    if (!peer) {
+        construct ? model.construct(in) : model.visit(in);
+        return;
+    }
+    auto fields = std::make_shared<SchemaReadFunctor>(in, construct ? peer->constructed : peer->serialized);
+    construct ? model.construct(fields) : model.visit(fields);
+    fields->finish();
+}
+
+void beginConstruct(Ptr<Connection> conn, Ptr<Model> model) {
+// Start a CONSTRUCT message, which binds the model's id on the peer to the
+// peer's model at the same path, and carries the model's type, so that the
+// peer can create the model if it has none there, and the constructor fields.
+// The caller follows it with the model's state.
+    sendSchema(conn, schema(*model));
+    beginMessage(conn, model->id(), jet2::Model::CONSTRUCT);
+    auto path = model->table() ? model->table()->path(model->id()) : std::string();
+    auto type = std::string(typeid(*model).name());
+    conn->messageOut()->val(path);
+    conn->messageOut()->val(type);
+    model->construct(conn->messageOut());
+    conn->model(model->id(), model);
+}
+
+void sendSnapshot(Ptr<Connection> conn, Ptr<Model> model) {
+// Encode the model into a snapshot, and then send it in full or as a delta
+// against the baseline for the connection.  The connection is TCP, so every
+// message sent is eventually applied by the peer in order; thus, the last
+// snapshot sent is the state the peer will hold when it reads the next
+// message.  If no field changed since the baseline, nothing is sent.  The
+// snapshot is shared by all connections, so the model is encoded once.  A
+// type that the peer encodes differently is always sent in full.
+    auto next = model->snapshot();
+    auto base = conn->baseline(model->id());
+
     if (!conn->model(model->id())) {
-        uint8_t const flags = jet2::Model::CONSTRUCT;
-        conn->out()->val(flags);
-        model->construct(conn->out());
-        conn->model(model->id(), model);
+        beginConstruct(conn, model);
+        endMessage(conn, next);
+    } else if (!base || base->fields() != next->fields() || peerSchema(conn, *model)) {
+        beginMessage(conn, model->id(), jet2::Model::SYNC);
+        endMessage(conn, next);
+    } else if (*base == *next) {
+        return; // Unchanged; the peer already has this state
     } else {
-        uint8_t const flags = jet2::Model::SYNC;
-        conn->out()->val(flags);
+        beginMessage(conn, model->id(), jet2::Model::DELTA);
+        next->deltaOut(conn->messageOut(), *base);
+        endMessage(conn);
+    }
+    conn->baseline(model->id(), next);
+}
+
+template <typename T>
+static void append(std::vector<char>& buf, T const& value) {
+    auto ptr = (char const*)&value;
+    buf.insert(buf.end(), ptr, ptr+sizeof(value));
+}
+
+static void appendVarint(std::vector<char>& buf, uint64_t value) {
+    char out[VARINT_MAX];
+    buf.insert(buf.end(), out, out+varintEncode(value, out));
+}
+
+void sendDatagram(Ptr<Connection> conn) {
+// Send the datagram being built, if it contains any updates
+    if (conn->udpOut.size() > DATAGRAM_HEADER_SIZE) {
+        conn->udp()->write(&conn->udpOut.front(), conn->udpOut.size());
+        conn->udpBytes = conn->udpBytes()+conn->udpOut.size();
+    }
+    conn->udpOut.clear();
+}
+
+void endDatagrams(Ptr<Connection> conn) {
+// Send the last datagram for the frame just built, so that no update waits
+// for the next frame, and move on to the next sequence number.
+    if (conn->udp()) {
+        sendDatagram(conn);
+        conn->udpSeq = conn->udpSeq()+1;
+    }
+}
+
+void sendSettle(Ptr<Connection> conn, Ptr<Model> model) {
+// Send a full update for the model over TCP, tagged with the current frame's
+// sequence number, so that the peer can discard older datagrams that arrive
+// after it.
+    beginMessage(conn, model->id(), jet2::Model::SETTLE);
+    conn->messageOut()->val(conn->udpSeq());
+    endMessage(conn, model->snapshot());
+}
+
+void sendUnreliable(Ptr<Connection> conn, Ptr<Model> model) {
+// Add a full update for the model to the current datagram.  The delta
+// baseline is discarded, because the peer may not receive the update; thus,
+// the next TCP message for the model is a full update.
+    auto const id = model->id();
+    auto next = model->snapshot();
+    conn->baseline(id, Ptr<Snapshot const>());
+
+    auto const len = varintSize(id)+varintSize(next->size())+next->size();
+    if (DATAGRAM_HEADER_SIZE+len > DATAGRAM_SIZE) {
+        sendSettle(conn, model); // Too big for a datagram
+        return;
+    }
+    if (conn->udpOut.size()+len > DATAGRAM_SIZE) {
+        sendDatagram(conn);
+    }
+    if (conn->udpOut.empty()) {
+        append(conn->udpOut, conn->udpSeq());
+        append(conn->udpOut, jet2::tickId);
+        append(conn->udpOut, tickSimulated(conn));
+    }
+    appendVarint(conn->udpOut, id);
+    appendVarint(conn->udpOut, next->size());
+    conn->udpOut.insert(conn->udpOut.end(), next->data(), next->data()+next->size());
+
+    auto const index = modelIndex(id);
+    if (index >= conn->udpSent.size()) {
+        conn->udpSent.resize(index+1);
+    }
+    if (!conn->udpSent[index]) {
+        conn->udpUnsettled.push_back(id);
+    }
+    conn->udpSent[index] = conn->udpSeq();
+}
+
+void settle(Ptr<Connection> conn, Ptr<ModelTable> mt) {
+// Send a reliable update for each model that was sent unreliably in an
+// earlier frame, but didn't change in this frame.  The last datagram for the
+// model may have been lost, and the model won't be sent again until it
+// changes, so the peer needs the final state.
+    auto& unsettled = conn->udpUnsettled;
+    for (auto i = unsettled.begin(); i != unsettled.end();) {
+        auto const id = *i;
+        auto const index = modelIndex(id);
+        if (conn->udpSent[index] == conn->udpSeq()) {
+            ++i; // Still changing
+            continue;
+        }
+        auto model = mt->model(id);
+        if (model && conn->model(id)) {
+            sendSettle(conn, model);
+        }
+        conn->udpSent[index] = 0;
+        i = unsettled.erase(i);
+    }
+}
+
+void sendModel(Ptr<Connection> conn, Ptr<Model> model) {
+// Send a single message for a single model, as part of the current frame.
+    if (model->id() == 0 || model->syncMode() == Model::DISABLED || model->netMode() == Model::INPUT) { 
+        return;
+    }
+    if (conn->udp() && model->syncMode() == Model::CHANGED && conn->model(model->id())) {
+        sendUnreliable(conn, model);
+    } else if (conn->delta()) {
+        sendSnapshot(conn, model);
+    } else {
+        if (!conn->model(model->id())) {
+            beginConstruct(conn, model);
+        } else {
+            beginMessage(conn, model->id(), jet2::Model::SYNC);
+        }
+        endMessage(conn, model->snapshot());
     }
-    conn->out()->val(model);
     if (model->syncMode() == Model::ONCE) {
         model->syncMode = Model::DISABLED;
     }
-    conn->state = Connection::IDLE;
-    conn->event.notifyAll();
 }
 
-void sendMessages(Ptr<Connection> conn, Ptr<Table> db, Ptr<ModelTable> mt) {
-// Send a message for each model in the database (recursively)
-    for (auto entry : *db) {
-        if (entry.second.cast<Object>() == mt) {
-        } else if (auto db = entry.second.cast<Table>()) {
-            sendMessages(conn, db, mt);
-        } else if (auto model = entry.second.cast<Model>()) {
-            sendMessage(conn, entry.second.cast<Model>());
+bool busy(Ptr<Connection> conn) {
+// Returns true if another coroutine is sending, or if the peer isn't reading
+// fast enough to keep the socket's send queue under the limit.
+    if (conn->state() == Connection::SENDING) {
+        return true;
+    }
+    return conn->maxUnsent() && conn->writer()->unsent() > conn->maxUnsent();
+}
+
+void outboxIs(Ptr<Connection> conn, Ptr<Model> model) {
+// Queue a message.  A model that is already queued isn't queued again; the
+// message sends the model's state at the time it goes out.
+    for (auto const& queued : conn->outbox) {
+        if (queued->id() == model->id()) {
+            return;
+        }
+    }
+    conn->outbox.push_back(model);
+}
+
+void sendOutbox(Ptr<Connection> conn) {
+// Send the queued messages, as part of the current frame.
+    auto outbox = std::vector<Ptr<Model>>();
+    outbox.swap(conn->outbox);
+    for (auto model : outbox) {
+        sendModel(conn, model);
+    }
+}
+
+void sendQueued(Ptr<Connection> conn) {
+// Send messages that were queued while the connection was held, before
+// letting it go.  Stops if the socket backs up; the send loop picks up the
+// rest with the next frame.
+    while (!conn->outbox.empty()) {
+        if (conn->maxUnsent() && conn->writer()->unsent() > conn->maxUnsent()) {
+            return;
+        }
+        beginFrame(conn);
+        sendOutbox(conn);
+        endFrame(conn);
+        endDatagrams(conn);
+        conn->writer()->flush();
+    }
+}
+
+void sendMessage(Ptr<Connection> conn, Ptr<Model> model) {
+// Send a single model in a frame of its own.  The call never blocks: if
+// another coroutine is sending a frame, or the socket is backed up, the
+// message is queued and goes out with the next frame.  Repeated messages for
+// the same model are conflated while they wait.
+    outboxIs(conn, model);
+    if (busy(conn)) {
+        return;
+    }
+    acquire(conn);
+    beginFrame(conn);
+    sendOutbox(conn);
+    endFrame(conn);
+    endDatagrams(conn);
+    conn->writer()->flush();
+    sendQueued(conn);
+    release(conn);
+}
+
+void sendDestroy(Ptr<Connection> conn, Ptr<Model> model) {
+// Tell the peer that the model left its area of interest, and forget what
+// was sent, so that the model is constructed again if it re-enters.
+    beginMessage(conn, model->id(), jet2::Model::DESTROY);
+    endMessage(conn);
+    conn->model.erase(model->id());
+    conn->baseline.erase(model->id());
+}
+
+void sendRemove(Ptr<Connection> conn, ModelId id) {
+// Tell the peer that the model was deleted, so that it deletes its copy, and
+// forget everything sent for the model.  It's sent whether or not the model
+// is in scope, since the peer keeps a copy that left scope; a peer that never
+// saw the model ignores it.
+    beginMessage(conn, id, jet2::Model::REMOVE);
+    endMessage(conn);
+    conn->model.erase(id);
+    conn->baseline.erase(id);
+    auto const index = modelIndex(id);
+    if (index < conn->priority.size()) {
+        conn->priority[index].valueIs(0.f);
+    }
+    if (index < conn->udpSent.size() && conn->udpSent[index]) {
+        auto& unsettled = conn->udpUnsettled;
+        unsettled.erase(std::remove(unsettled.begin(), unsettled.end(), id), unsettled.end());
+        conn->udpSent[index] = 0;
+    }
+}
+
+bool inScope(Ptr<Connection> conn, Ptr<Model> model) {
+// Returns true if the model is in the connection's area of interest.  Only
+// CHANGED models are filtered; ONCE models (e.g., replies) are always sent.
+    auto focus = conn->focus();
+    if (!focus || !conn->relevance() || model->syncMode() != Model::CHANGED) {
+        return true;
+    }
+    return model == focus || conn->relevance()(*focus, *model);
+}
+
+void scopeIs(Ptr<Connection> conn, Ptr<Model> model, bool dirty) {
+// Queue the model if it is in scope and changed, or if it just entered scope;
+// destroy it on the peer if it just left scope.
+    if (model->id() == 0 || model->syncMode() == Model::DISABLED || model->netMode() == Model::INPUT) {
+        return;
+    }
+    auto const sent = bool(conn->model(model->id()));
+    if (inScope(conn, model)) {
+        if (dirty || !sent) {
+            conn->pending.push_back(model->id());
+        }
+    } else if (sent) {
+        sendDestroy(conn, model);
+    }
+}
+
+void scopeSweep(Ptr<Connection> conn, Ptr<ModelTable> mt) {
+// Re-check the scope of models that didn't change.  The models on the peer
+// are checked every frame, since they leave scope when the focus moves away.
+// The rest are checked a slice per frame, so a model that stays still enters
+// scope at most 'scopeFrames' frames after the focus reaches it.  A frame thus
+// costs the models in scope plus a slice of the table, not the whole table.
+    auto sent = std::vector<ModelId>();
+    for (auto const& entry : conn->model) {
+        sent.push_back(entry.first);
+    }
+    for (auto id : sent) {
+        if (auto model = mt->model(id)) {
+            scopeIs(conn, model, false);
+        }
+    }
+    auto const frames = std::max(conn->scopeFrames(), uint32_t(1));
+    auto const slice = std::max(SCOPE_SWEEP_MIN, (mt->size()+frames-1)/frames);
+    auto const slots = mt->size() ? mt->size()-1 : 0; // Slot 0 is unused
+    auto cursor = conn->scopeCursor();
+    for (size_t i = 0; i < std::min(slice, slots); ++i) {
+        cursor = (cursor+1 < mt->size()) ? cursor+1 : 1;
+        auto model = mt->modelAt(cursor);
+        if (model && !conn->model(model->id())) {
+            scopeIs(conn, model, false);
+        }
+    }
+    conn->scopeCursor = cursor;
+}
+
+uint64_t bytesOut(Ptr<Connection> conn) {
+// Total bytes sent or queued on both channels
+    return conn->writer()->bytes()+conn->udpBytes()+conn->udpOut.size();
+}
+
+void schedule(Ptr<Connection> conn, Ptr<ModelTable> mt) {
+// Send the models queued for this frame.  With a budget, the models with the
+// highest accumulated priority go first, and each model's priority grows by
+// Model::priority for every frame it waits; thus, stale models eventually
+// win over important ones.  The model that crosses the budget is still sent
+// whole, so a frame may overshoot by one message.
+    auto& pending = conn->pending;
+    auto& priority = conn->priority;
+    std::sort(pending.begin(), pending.end());
+    pending.erase(std::unique(pending.begin(), pending.end()), pending.end());
+    if (conn->budget()) {
+        if (priority.size() < mt->size()) {
+            priority.resize(mt->size(), Accumulator<float>(0.f));
+        }
+        for (auto id : pending) {
+            priority[modelIndex(id)].valueInc(mt->model(id)->priority());
+        }
+        std::stable_sort(pending.begin(), pending.end(), [&](ModelId a, ModelId b) {
+            return priority[modelIndex(a)].value() > priority[modelIndex(b)].value();
+        });
+    }
+    auto const start = bytesOut(conn);
+    for (auto id : pending) {
+        if (conn->budget() && bytesOut(conn)-start >= conn->budget()) {
+            conn->dirty()->modelIs(id); // Deferred to the next frame
         } else {
-            assert(!"not a model");
+            sendModel(conn, mt->model(id));
+            if (conn->budget()) {
+                priority[modelIndex(id)].valueIs(0.f);
+            }
         }
     }
+    pending.clear();
 }
 
 void sendFrame(Ptr<Connection> conn, Ptr<Table> db) {
-// Send one frame of data
+// Send one frame of data, containing each model that changed since the last
+// frame.  The first frame for a connection contains every model.  With an
+// area of interest, models that didn't change are re-checked too, since the
+// focus model may have moved even if the other model did not; see
+// scopeSweep().  The models to send are queued first, and then scheduled
+// against the connection's budget.  Everything sent over TCP for this frame
+// goes in one frame envelope.  If the connection is backed up, the frame is
+// skipped; the models stay dirty, and go out with the next frame that isn't.
     auto mt = modelTable(db);
-    sendMessages(conn, db, mt);
+    if (!conn->dirty()) {
+        conn->dirty = std::make_shared<DirtySet>();
+        mt->dirtySetIs(conn->dirty());
+    }
+    if (conn->maxUnsent() && busy(conn)) {
+        conn->framesSkipped = conn->framesSkipped()+1;
+        return;
+    }
+    acquire(conn);
+    beginFrame(conn);
+    for (auto schema : conn->schemaReply) {
+        sendSchema(conn, schema);
+    }
+    conn->schemaReply.clear();
+    sendOutbox(conn);
+    for (auto id : conn->dirty()->drainDeleted()) {
+        sendRemove(conn, id); // Before any model that reuses the slot
+    }
+    for (auto id : conn->dirty()->drain()) {
+        if (auto model = mt->model(id)) {
+            scopeIs(conn, model, true);
+        }
+    }
+    if (conn->focus() && conn->relevance()) {
+        scopeSweep(conn, mt);
+    }
+    schedule(conn, mt);
+    if (conn->udp()) {
+        settle(conn, mt);
+    }
+    endFrame(conn);
+    endDatagrams(conn);
     conn->writer()->flush();
+    sendQueued(conn);
+    release(conn);
 }
 
 void send(Ptr<Connection> conn, Ptr<Table> db) {
@@ -134,38 +710,316 @@ void send(Ptr<Connection> conn) {
     send(conn, db);
 }
 
-void recvMessage(Ptr<Connection> conn, Ptr<ModelTable> mt) {
-// Receive one message from a connection.
-    auto modelId = ModelId(0);
-    conn->in()->val(modelId); 
+SeqId& udpSeqIn(Ptr<Connection> conn, ModelId id) {
+    auto const index = modelIndex(id);
+    if (index >= conn->udpSeqIn.size()) {
+        conn->udpSeqIn.resize(index+1);
+    }
+    return conn->udpSeqIn[index];
+}
+
+void authorityIs(Ptr<Model> model) {
+// Keep the state just received for a predicted model, before Predictor
+// replays inputs on top of it
+    if (model->predicted()) {
+        model->authority = model->snapshot();
+    }
+}
+
+void rewind(Ptr<Model> model) {
+// Put back the last state received for a predicted model.  A DELTA carries
+// only the fields that changed since that state; the rest must not keep
+// their predicted values, or Predictor would apply the same inputs twice.
+    auto const authority = model->authority();
+    if (!model->predicted() || !authority) {
+        return;
+    }
+    auto reader = std::make_shared<MemoryReader>();
+    reader->bufferIs(authority->data(), authority->size());
+    model->visit(std::make_shared<MemoryReadFunctor>(reader));
+}
+
+void recvSettle(Ptr<Connection> conn, Ptr<Model> model, Ptr<Schema const> peer) {
+// Receive a reliable update for a model that is also updated by datagrams.
+// If a newer datagram was already applied, the update is dropped.
+    auto seq = SeqId(0);
+    conn->messageIn()->val(seq);
+    auto& seqIn = udpSeqIn(conn, model->id());
+    if (seq >= seqIn) {
+        decode(conn->messageIn(), peer, *model, false);
+        authorityIs(model);
+        seqIn = seq;
+    }
+}
 
-    auto flags = uint8_t(0);
-    conn->in()->val(flags); 
+bool validPath(std::string const& path) {
+// Returns true if 'path' names an object beneath a table, so that it can be
+// looked up without tripping Table's asserts
+    return !path.empty() && path.front() != '/' && path.back() != '/' && path.find("//") == std::string::npos;
+}
 
-    auto model = mt->model(modelId);
-    assert(model && "model not found");
+bool vacant(Table& table, std::string const& path) {
+// Returns true if Table::objectIs() can create an object at 'path' without
+// colliding with anything: each table on the way is a table, if it exists,
+// and there's nothing at the end.
+    auto const slash = path.find('/');
+    auto const object = table.object<Object>(path.substr(0, slash));
+    if (slash == std::string::npos || !object) {
+        return !object;
+    }
+    auto const next = std::dynamic_pointer_cast<Table>(object);
+    return next && vacant(*next, path.substr(slash+1));
+}
+
+Ptr<Model> spawn(Ptr<Connection> conn, Ptr<ModelTable> mt, std::string const& path, std::string const& type) {
+// Create a model that the peer constructed and we don't have, if the
+// connection allows it, and the type is known.  The model is the peer's to
+// update, so it's an input.
+    if (!conn->spawn() || !vacant(*mt->root(), path)) {
+        return Ptr<Model>();
+    }
+    auto factory = modelFactory(type);
+    if (!factory) {
+        std::cerr << "warning: can't spawn model of unknown type " << type << std::endl;
+        return Ptr<Model>();
+    }
+    auto model = factory(*mt->root(), path);
+    model->netMode = Model::INPUT;
+    return model;
+}
+
+Ptr<Model> bind(Ptr<Connection> conn, Ptr<ModelTable> mt, ModelId id) {
+// Read the path and type from a CONSTRUCT, and bind the peer's id to our
+// model at that path, spawning it if need be.  The peer's ids mean nothing
+// here otherwise; a slot the peer reuses comes with a new generation, and so
+// with a new binding.
+    auto path = std::string();
+    auto type = std::string();
+    conn->messageIn()->val(path);
+    conn->messageIn()->val(type);
+    auto model = Ptr<Model>();
+    if (validPath(path) && mt->root()) {
+        model = mt->root()->object<Model>(path);
+        model = model ? model : spawn(conn, mt, path, type);
+    }
+    if (!model || model->table() != mt.get()) {
+        std::cerr << "warning: skipped CONSTRUCT for unknown model '" << path << "'" << std::endl;
+        conn->localId.erase(id);
+        return Ptr<Model>();
+    }
+    conn->localId(id, model->id());
+    return model;
+}
+
+Ptr<Model> recvMessage(Ptr<Connection> conn, Ptr<ModelTable> mt) {
+// Decode one message of the current frame, which is in messageReader().
+// Returns the model that was updated.  The message's id is the peer's, and
+// resolves to the model that the peer's last CONSTRUCT for it named.
+// Messages for unknown models are skipped, since the message length is known.
+    auto in = conn->messageIn();
+
+    auto tag = uint64_t(0);
+    in->valVarint(tag);
+    auto const id = ModelId(tag >> MESSAGE_FLAG_BITS);
+    auto const flags = uint8_t(tag & ((1 << MESSAGE_FLAG_BITS)-1));
+
+    if (flags == jet2::Model::SCHEMA) {
+        recvSchema(conn);
+        return Ptr<Model>(); // Not for a model
+    }
+    auto model = Ptr<Model>();
+    if (flags == jet2::Model::CONSTRUCT) {
+        model = bind(conn, mt, id);
+    } else if (auto const local = conn->localId(id)) {
+        model = mt->model(local);
+    }
+    if (!model && flags == jet2::Model::CONSTRUCT) {
+        return Ptr<Model>(); // Not bound; bind() said why
+    } else if (!model && flags == jet2::Model::REMOVE) {
+        conn->localId.erase(id);
+        return Ptr<Model>(); // Never constructed here, or already deleted
+    } else if (!model) {
+        std::cerr << "warning: skipped message for unknown model " << id << std::endl;
+        return Ptr<Model>();
+    }
+    if (flags == jet2::Model::REMOVE && model->netMode() != Model::INPUT) {
+        std::cerr << "warning: ignored REMOVE for non-input model " << id << std::endl;
+        return Ptr<Model>(); // Only the model's sender may delete it
+    } else if (flags == jet2::Model::REMOVE) {
+        conn->localId.erase(id);
+        mt->objectDel(model->id());
+        return Ptr<Model>(); // No payload
+    }
     assert(model->netMode() == Model::INPUT && "received message for non-input model");
     // If is marked INPUT, then the socket shouldn't receive any messages for
     // that model.  Receiving a message indicates a programming error.
+    auto const peer = peerSchema(conn, *model);
+    if (flags == jet2::Model::CONSTRUCT && conn->schemas()) {
+        schemaReplyIs(conn, schema(*model)); // So the peer can send deltas
+    }
+    if (flags == jet2::Model::DELTA && peer) {
+        std::cerr << "warning: skipped delta for model " << id << ", encoded differently" << std::endl;
+        return Ptr<Model>(); // The peer doesn't send these
+    }
+    if (flags == jet2::Model::CONSTRUCT || flags == jet2::Model::DESTROY) {
+        model->history = Ptr<Interpolator>(); // Don't interpolate across the gap
+    }
     if (flags == jet2::Model::CONSTRUCT) {
-        model->construct(conn->in());
+        decode(in, peer, *model, true);
+        model->inScope = true;
+    }
+    if (flags == jet2::Model::DESTROY) {
+        model->inScope = false; // No payload
+    } else if (flags == jet2::Model::DELTA) {
+        rewind(model);
+        conn->inDelta()->reset();
+        model->visit(conn->inDelta());
+        authorityIs(model);
+    } else if (flags == jet2::Model::SETTLE) {
+        recvSettle(conn, model, peer);
+    } else {
+        decode(in, peer, *model, false);
+        authorityIs(model);
+    }
+    return model;
+}
+
+void historyIs(Ptr<Model> model, TickId tick) {
+// Record the model's new state in its history, for interpolation.  Predicted
+// models are drawn at their current state, so they have no history.  A model
+// out of scope has no new state; its last position isn't a sample.
+    if (model->predicted() || !model->inScope()) {
+        return;
+    } else if (!model->history()) {
+        model->history = std::make_shared<Interpolator>();
+    }
+    model->history()->sampleIs(tick, model->position(), model->rotation());
+}
+
+void applyFrame(Ptr<Connection> conn, Ptr<ModelTable> mt, TickId tick, TickId ack, uint32_t messages);
+
+void recvFrame(Ptr<Connection> conn, Ptr<ModelTable> mt) {
+// Receive one frame from a connection.  The whole frame is read into the
+// reader's buffer before any of it is applied, and waiters are notified only
+// after the last message, so other coroutines never see half of a tick.  The
+// header's 'ack' is the last of our frames the peer had simulated; each model
+// received is stamped with it, for Predictor.
+    auto tick = TickId(0);
+    auto ack = TickId(0);
+    auto sent = NetTime(0);
+    auto echo = NetTime(0);
+    auto hold = uint32_t(0);
+    auto phase = uint32_t(0);
+    auto messages = uint32_t(0);
+    auto len = FrameLen(0);
+    conn->in()->val(tick);
+    conn->in()->val(ack);
+    conn->in()->val(sent);
+    conn->in()->val(echo);
+    conn->in()->val(hold);
+    conn->in()->val(phase);
+    conn->in()->val(messages);
+    conn->in()->val(len);
+    if (len > MAX_FRAME_SIZE) {
+        std::cerr << "error: frame too large: " << len << std::endl;
+        throw coro::SocketCloseException(); // Don't buffer whatever the peer claims
+    }
+    conn->clock()->recvIs(tick, sent, echo, hold, phase);
+    auto frame = conn->frameReader();
+    frame->bufferIs(conn->reader()->view(len), len);
+    if (conn->compress() && len) {
+        auto rawLen = FrameLen(0);
+        frame->read((char*)&rawLen, sizeof(rawLen));
+        auto& decompressor = conn->decompressor;
+        if (rawLen > MAX_FRAME_SIZE) {
+            std::cerr << "error: compressed frame too large: " << rawLen << std::endl;
+            throw coro::SocketCloseException();
+        }
+        if (frame->error() || !decompressor.decompress(frame->data(), frame->remaining(), rawLen)) {
+            std::cerr << "error: corrupt compressed frame" << std::endl;
+            throw coro::SocketCloseException(); // The dictionaries no longer match
+        }
+        frame->bufferIs(decompressor.data(), decompressor.size());
+    }
+    if (recording(conn)) {
+        conn->recorder()->frameIs(Recorder::IN, tick, ack, messages, frame->data(), frame->remaining());
+    }
+    conn->frames = conn->frames()+1;
+    applyFrame(conn, mt, tick, ack, messages);
+}
+
+void applyFrame(Ptr<Connection> conn, Ptr<ModelTable> mt, TickId tick, TickId ack, uint32_t messages) {
+// Decode and apply the messages in the connection's frame reader, and then
+// notify the models that changed.  Every frame is applied, in the order
+// received: TCP doesn't reorder, and later frames depend on earlier ones
+// (delta baselines, CONSTRUCT).  The message count comes from the peer, so
+// decoding stops when the frame body runs out, whatever the count says.
+    if (conn->tickInAt() != jet2::tickId) {
+        conn->tickInBefore = conn->tickIn(); // Stepped by the current tick
+        conn->tickInAt = jet2::tickId;
     }
-    conn->in()->val(model);
-    model->tickId = jet2::tickId; // Note the tickId of this model @ message receive
-    model->notifyAll();
+    conn->tickIn = tick;
+
+    auto frame = conn->frameReader();
+    auto& received = conn->received;
+    received.clear();
+    for (auto i = uint32_t(0); i < messages && frame->remaining(); ++i) {
+        auto const messageLen = MessageLen(frame->varint());
+        auto message = frame->view(messageLen);
+        if (!message || frame->error()) {
+            std::cerr << "warning: truncated frame" << std::endl;
+            break;
+        }
+        conn->messageReader()->bufferIs(message, messageLen);
+        if (auto model = recvMessage(conn, mt)) {
+            received.push_back(model);
+        }
+    }
+    for (auto model : received) {
+        model->tickId = jet2::tickId; // Note the tickId of this model @ message receive
+        model->tickAck = ack;
+        historyIs(model, tick);
+        model->notifyAll();
+    }
+    received.clear();
 }
 
-void recvMessage(Ptr<Connection> conn, Ptr<Table> db) {
+void recvFrame(Ptr<Connection> conn, Ptr<Table> db) {
     auto mt = modelTable(db);
-    recvMessage(conn, mt);
+    recvFrame(conn, mt);
 }
 
 
+void replay(Ptr<Replay> log, Ptr<Connection> conn, Ptr<Table> db, bool realtime) {
+// Apply the frames received in a recorded log, as though they had arrived on
+// 'conn'.  If 'realtime' is set, the frames are spaced as they were recorded;
+// otherwise, they are applied as fast as possible.  Frames that were sent are
+// skipped.
+    auto mt = modelTable(db);
+    auto frame = Replay::Frame();
+    auto first = NetTime(0);
+    auto const start = NetClock::now();
+    while (log->next(frame)) {
+        if (frame.dir != Recorder::IN) {
+            continue;
+        }
+        if (realtime) {
+            first = first ? first : frame.time;
+            auto const wait = (frame.time-first)-(NetClock::now()-start);
+            if (wait > 0) {
+                coro::sleep(coro::Time::microsec(wait));
+            }
+        }
+        conn->frameReader()->bufferIs(frame.data, frame.len);
+        applyFrame(conn, mt, frame.tick, frame.ack, frame.messages);
+    }
+}
+
 void recv(Ptr<Connection> conn, Ptr<Table> db) {
-// Receive a stream of messages from a connection
+// Receive a stream of frames from a connection
     auto mt = modelTable(db);
     for (;;) {
-        recvMessage(conn, mt);
+        recvFrame(conn, mt);
     } 
 }
 
@@ -174,6 +1028,66 @@ void recv(Ptr<Connection> conn) {
     recv(conn, db);
 }
 
+void recvDatagram(Ptr<Connection> conn, Ptr<Table> db) {
+// Receive datagrams from the unreliable channel until the socket is closed.
+// Each datagram holds updates from one frame, tagged with the frame's sequence
+// number, the sender's tick, and the last of our ticks the sender received.
+// An update is applied only if it is newer than the last update applied to
+// the model (latest wins); stale updates are skipped unread.
+    auto mt = modelTable(db);
+    auto datagram = std::make_shared<MemoryReader>();
+    auto message = std::make_shared<MemoryReader>();
+    auto in = Ptr<Functor>(new MemoryReadFunctor(datagram));
+    auto messageIn = Ptr<Functor>(new MemoryReadFunctor(message));
+    auto buf = std::vector<char>(DATAGRAM_SIZE);
+    for (;;) {
+        auto len = conn->udp()->read(&buf.front(), buf.size());
+        if (len <= 0) {
+            throw coro::SocketCloseException();
+        }
+        datagram->bufferIs(&buf.front(), len);
+        auto seq = SeqId(0);
+        auto tick = TickId(0);
+        auto ack = TickId(0);
+        in->val(seq);
+        in->val(tick);
+        in->val(ack);
+        while (datagram->remaining() > 0) {
+            auto id = uint64_t(0);
+            auto size = uint64_t(0);
+            in->valVarint(id);
+            in->valVarint(size);
+            if (datagram->error() || ModelId(id) != id || size > DATAGRAM_SIZE || size > datagram->remaining()) {
+                break; // Malformed datagram
+            }
+            auto const local = conn->localId(ModelId(id));
+            auto model = local ? mt->model(local) : Ptr<Model>();
+            if (model && model->netMode() == Model::INPUT) {
+                auto& seqIn = udpSeqIn(conn, model->id());
+                if (seq > seqIn) {
+                    message->bufferIs(datagram->data(), size_t(size));
+                    decode(messageIn, peerSchema(conn, *model), *model, false);
+                    authorityIs(model);
+                    seqIn = seq;
+                    model->tickId = jet2::tickId;
+                    model->tickAck = ack;
+                    historyIs(model, tick);
+                    model->notifyAll();
+                }
+            }
+            datagram->skip(size_t(size));
+        }
+    }
+}
+
+Ptr<coro::Socket> datagramSocket(uint16_t port, std::string const& addr) {
+// Create a UDP socket bound to the given local address and port
+    auto sd = std::make_shared<coro::Socket>(SOCK_DGRAM);
+    sd->setsockopt(SOL_SOCKET, SO_REUSEADDR, 1);
+    sd->bind(coro::SocketAddr(addr, port));
+    return sd;
+}
+
 void sync(sf::Time const& delta) {
     assert(!"not implemented");
 }
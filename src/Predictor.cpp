@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "jet2/Common.hpp"
+#include "jet2/Predictor.hpp"
+#include "jet2/Reader.hpp"
+#include "jet2/Snapshot.hpp"
+
+namespace jet2 {
+
+Predictor::Predictor(Ptr<Model> model, Ptr<Model> input, Ptr<Model> replay, Step step) {
+    model_ = model;
+    input_ = input;
+    replay_ = replay;
+    step_ = step;
+    reader_ = std::make_shared<MemoryReader>();
+    in_ = std::make_shared<MemoryReadFunctor>(reader_);
+    model_->predicted = true;
+    model_->history = Ptr<Interpolator>();
+    model_->authority = model_->snapshot(); // Not yet predicted
+    received_ = model_->tickId();
+    tickListenerIs(this);
+}
+
+Predictor::~Predictor() {
+    tickListenerDel(this);
+}
+
+void Predictor::reconcile() {
+// Rewind and replay: the model holds the server's state as of the model's
+// tickAck, so drop the inputs the server has applied, and re-apply the rest
+// in order.
+    while (!history_.empty() && history_.front().tick <= model_->tickAck()) {
+        history_.pop_front();
+    }
+    for (auto const& input : history_) {
+        reader_->bufferIs(input.snapshot->data(), input.snapshot->size());
+        replay_->visit(in_);
+        step_(model_, replay_);
+    }
+}
+
+void Predictor::tick() {
+// Reconcile with the server's state if a new one arrived since the last tick,
+// and then predict this tick's input.
+    if (model_->tickId() != received_) {
+        received_ = model_->tickId();
+        reconcile();
+    }
+    if (history_.size() == CAPACITY) {
+        history_.pop_front(); // The server is too far behind; stop replaying the oldest
+    }
+    Input const input = { tickId, input_->snapshot() };
+    history_.push_back(input);
+    step_(model_, input_);
+}
+
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "jet2/Common.hpp"
+#include "jet2/Quantize.hpp"
+
+namespace jet2 {
+
+QuantizeBounds worldBounds(sfr::Vector(-1024, -1024, -1024), sfr::Vector(1024, 1024, 1024));
+
+void BitWriter::write(uint32_t value, uint8_t bits) {
+// Append the low 'bits' bits of value to the buffer
+    assert(bits <= 32);
+    bits_ |= uint64_t(value & ((uint64_t(1) << bits)-1)) << count_;
+    count_ += bits;
+    while (count_ >= 8) {
+        *buf_++ = char(bits_ & 0xff);
+        bits_ >>= 8;
+        count_ -= 8;
+    }
+}
+
+void BitWriter::flush() {
+// Write any partial byte that remains
+    if (count_ > 0) {
+        *buf_++ = char(bits_ & 0xff);
+        bits_ = 0;
+        count_ = 0;
+    }
+}
+
+uint32_t BitReader::read(uint8_t bits) {
+// Read the next 'bits' bits from the buffer
+    assert(bits <= 32);
+    while (count_ < bits) {
+        bits_ |= uint64_t(uint8_t(*buf_++)) << count_;
+        count_ += 8;
+    }
+    auto const value = uint32_t(bits_ & ((uint64_t(1) << bits)-1));
+    bits_ >>= bits;
+    count_ -= bits;
+    return value;
+}
+
+static uint32_t quantize(float value, float min, float max, uint8_t bits) {
+// Map value in [min, max] to an integer in [0, 2^bits-1].  The arithmetic is
+// in double, since a float can't hold a step plus the half used for rounding
+// once 'bits' nears 24.
+    assert(bits <= QuantizeBounds::MAX_BITS);
+    auto const steps = double((uint64_t(1) << bits)-1);
+    auto const t = (double(value)-min)/(double(max)-min);
+    auto const clamped = std::min(std::max(t, 0.), 1.);
+    return uint32_t(std::floor(clamped*steps+.5));
+}
+
+static float dequantize(uint32_t value, float min, float max, uint8_t bits) {
+    auto const steps = double((uint64_t(1) << bits)-1);
+    return float(min+(double(max)-min)*(value/steps));
+}
+
+void QuantizedVector::encode(sfr::Vector const& in, char* out) const {
+    auto const& b = bounds_;
+    auto writer = BitWriter(out);
+    writer.write(quantize(in.x, b.min.x, b.max.x, b.bits), b.bits);
+    writer.write(quantize(in.y, b.min.y, b.max.y, b.bits), b.bits);
+    writer.write(quantize(in.z, b.min.z, b.max.z, b.bits), b.bits);
+    writer.flush();
+}
+
+void QuantizedVector::decode(char const* in, sfr::Vector& out) const {
+    auto const& b = bounds_;
+    auto reader = BitReader(in);
+    out.x = dequantize(reader.read(b.bits), b.min.x, b.max.x, b.bits);
+    out.y = dequantize(reader.read(b.bits), b.min.y, b.max.y, b.bits);
+    out.z = dequantize(reader.read(b.bits), b.min.z, b.max.z, b.bits);
+}
+
+static float const SMALLEST_THREE_MAX = 0.70710678f; // 1/sqrt(2)
+
+void QuantizedQuaternion::encode(sfr::Quaternion const& in, char* out) const {
+// The largest component is dropped; the other three are in the range
+// [-1/sqrt(2), 1/sqrt(2)].  The quaternion is negated if necessary so that
+// the dropped component is positive (q and -q are the same rotation).
+    float q[4] = { in.x, in.y, in.z, in.w };
+    auto largest = 0;
+    for (auto i = 1; i < 4; ++i) {
+        if (std::abs(q[i]) > std::abs(q[largest])) {
+            largest = i;
+        }
+    }
+    auto const sign = q[largest] < 0 ? -1.f : 1.f;
+    auto writer = BitWriter(out);
+    writer.write(largest, 2);
+    for (auto i = 0; i < 4; ++i) {
+        if (i != largest) {
+            writer.write(quantize(sign*q[i], -SMALLEST_THREE_MAX, SMALLEST_THREE_MAX, BITS), BITS);
+        }
+    }
+    writer.flush();
+}
+
+void QuantizedQuaternion::decode(char const* in, sfr::Quaternion& out) const {
+    float q[4];
+    auto reader = BitReader(in);
+    auto const largest = reader.read(2);
+    auto sum = 0.f;
+    for (auto i = 0; i < 4; ++i) {
+        if (uint32_t(i) != largest) {
+            q[i] = dequantize(reader.read(BITS), -SMALLEST_THREE_MAX, SMALLEST_THREE_MAX, BITS);
+            sum += q[i]*q[i];
+        }
+    }
+    q[largest] = std::sqrt(std::max(0.f, 1.f-sum));
+    out.x = q[0];
+    out.y = q[1];
+    out.z = q[2];
+    out.w = q[3];
+}
+
+}
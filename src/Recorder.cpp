@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "jet2/Common.hpp"
+#include "jet2/Recorder.hpp"
+#include "jet2/NetClock.hpp"
+#include "jet2/Exception.hpp"
+#include <atomic>
+
+namespace jet2 {
+
+static char const LOG_MAGIC[] = "JET2LOG"; // Includes the terminator
+static size_t const LOG_HEADER_SIZE = sizeof(LOG_MAGIC);
+static size_t const RECORD_HEADER_SIZE = sizeof(NetTime)+sizeof(uint8_t)+2*sizeof(TickId)+2*sizeof(uint32_t);
+
+template <typename T>
+static char* put(char* out, T const& value) {
+    memcpy(out, &value, sizeof(value));
+    return out+sizeof(value);
+}
+
+template <typename T>
+static char const* get(char const* in, T& value) {
+    memcpy(&value, in, sizeof(value));
+    return in+sizeof(value);
+}
+
+Recorder::Recorder(std::string const& path) : file_(path, true) {
+    file_.capacityIs(MIN_CAPACITY);
+    memcpy(file_.data(), LOG_MAGIC, LOG_HEADER_SIZE);
+    file_.sizeIs(LOG_HEADER_SIZE);
+}
+
+void Recorder::frameIs(Direction dir, TickId tick, TickId ack, uint32_t messages, char const* data, size_t len) {
+// Append a frame to the log.  The mapping doubles in size when it fills up.
+// The record is written with direction END, and the direction is filled in
+// after the rest; until then, a reader sees the end of the log.
+    auto const offset = file_.size();
+    auto const end = offset+RECORD_HEADER_SIZE+len;
+    if (end > file_.capacity()) {
+        file_.capacityIs(std::max(end, 2*file_.capacity()));
+    }
+    auto out = file_.data()+offset;
+    out = put(out, NetClock::now());
+    auto const direction = out;
+    out = put(out, uint8_t(END));
+    out = put(out, tick);
+    out = put(out, ack);
+    out = put(out, messages);
+    out = put(out, uint32_t(len));
+    if (len) {
+        memcpy(out, data, len);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    put(direction, uint8_t(dir));
+    file_.sizeIs(end);
+    ++frames_;
+}
+
+Replay::Replay(std::string const& path) : file_(path, false), offset_(LOG_HEADER_SIZE) {
+    if (file_.size() < LOG_HEADER_SIZE || memcmp(file_.data(), LOG_MAGIC, LOG_HEADER_SIZE)) {
+        throw ResourceException("not a replication log: "+path);
+    }
+}
+
+void Replay::rewind() {
+// Start again from the first frame
+    offset_ = LOG_HEADER_SIZE;
+}
+
+bool Replay::next(Frame& frame) {
+// Read the next frame.  Returns false at the end of the log, or if the last
+// record is incomplete.
+    if (offset_+RECORD_HEADER_SIZE > file_.size()) {
+        return false;
+    }
+    auto in = (char const*)file_.data()+offset_;
+    auto dir = uint8_t(0);
+    auto len = uint32_t(0);
+    in = get(in, frame.time);
+    in = get(in, dir);
+    in = get(in, frame.tick);
+    in = get(in, frame.ack);
+    in = get(in, frame.messages);
+    in = get(in, len);
+    if ((dir != Recorder::IN && dir != Recorder::OUT) || offset_+RECORD_HEADER_SIZE+len > file_.size()) {
+        return false;
+    }
+    frame.dir = Recorder::Direction(dir);
+    frame.data = in;
+    frame.len = len;
+    offset_ += RECORD_HEADER_SIZE+len;
+    return true;
+}
+
+}
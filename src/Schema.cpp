@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "jet2/Common.hpp"
+#include "jet2/Schema.hpp"
+#include "jet2/Table.hpp"
+
+namespace jet2 {
+
+// Limits on a schema read from a peer.  A schema over a limit is corrupt (or
+// hostile), and closes the connection; it is never truncated, since the rest
+// of it would be read as whatever follows.
+static size_t const MAX_FIELDS = 4096; // Per list
+static size_t const MAX_SCHEMAS = 1024; // Per handshake
+static size_t const MAX_TYPE_NAME = 1024; // In bytes
+static size_t const MAX_SKIP = 1 << 16; // Bytes skipped per read
+
+class SchemaFunctor : public Functor {
+// Records the kind and size of each field serialized through the functor
+public:
+    using Functor::val;
+    using Functor::valVarint;
+    SchemaFunctor(std::vector<Schema::Field>& field) : field_(field) {}
+
+    virtual void val(char* buf, size_t len) {
+        field_.push_back(Schema::field(Schema::FIXED, len));
+    }
+
+    virtual void val(std::string& in) {
+        field_.push_back(Schema::field(Schema::VARINT));
+        field_.push_back(Schema::field(Schema::BYTES));
+    }
+
+    virtual void valVarint(uint64_t& in) {
+        field_.push_back(Schema::field(Schema::VARINT));
+    }
+
+    virtual void valPacked(char* buf, size_t len, uint32_t const* end, size_t fields) {
+        auto begin = uint32_t(0);
+        for (size_t i = 0; i < fields; ++i) {
+            val(buf+begin, end[i]-begin);
+            begin = end[i];
+        }
+    }
+
+private:
+    std::vector<Schema::Field>& field_;
+};
+
+static void visitFields(Ptr<Functor> out, std::vector<Schema::Field>& field) {
+    auto count = uint64_t(field.size());
+    out->valVarint(count);
+    if (count > MAX_FIELDS) {
+        throw coro::SocketCloseException();
+    }
+    field.resize(size_t(count));
+    for (auto& entry : field) {
+        out->valVarint(entry);
+    }
+}
+
+static void hashBytes(uint64_t& hash, void const* buf, size_t len) {
+// FNV-1a
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= ((uint8_t const*)buf)[i];
+        hash *= 0x100000001b3ull;
+    }
+}
+
+void Schema::hashIs() {
+// Compute the hash of the type name and both field lists.  Peers compare
+// hashes to decide whether a type is encoded the same way on both sides.
+    auto value = uint64_t(0xcbf29ce484222325ull);
+    hashBytes(value, type().data(), type().size());
+    auto const constructedLen = uint32_t(constructed.size());
+    hashBytes(value, &constructedLen, sizeof(constructedLen));
+    for (auto field : constructed) {
+        hashBytes(value, &field, sizeof(field));
+    }
+    for (auto field : serialized) {
+        hashBytes(value, &field, sizeof(field));
+    }
+    hash = value;
+}
+
+void Schema::visit(Ptr<Functor> out) {
+// The type name is encoded like any string, but its length is checked before
+// anything is allocated for it.
+    auto name = type();
+    auto len = uint64_t(name.size());
+    out->valVarint(len);
+    if (len > MAX_TYPE_NAME) {
+        throw coro::SocketCloseException();
+    }
+    name.resize(size_t(len));
+    if (len) {
+        out->val(&name[0], name.size());
+    }
+    type = name;
+    out->val(hash);
+    visitFields(out, constructed);
+    visitFields(out, serialized);
+}
+
+void SchemaList::visit(Ptr<Functor> out) {
+    auto count = uint64_t(schema.size());
+    out->valVarint(count);
+    if (count > MAX_SCHEMAS) {
+        throw coro::SocketCloseException();
+    }
+    schema.resize(size_t(count));
+    for (auto& entry : schema) {
+        if (!entry) {
+            entry = std::make_shared<Schema>();
+        }
+        out->val(entry);
+    }
+}
+
+void SchemaReadFunctor::val(char* buf, size_t len) {
+    if (index_ < field_.size() && field_[index_] == Schema::field(Schema::FIXED, len)) {
+        ++index_;
+        in_->val(buf, len);
+    } else {
+        skip();
+    }
+}
+
+void SchemaReadFunctor::val(std::string& in) {
+    auto const varint = Schema::field(Schema::VARINT);
+    auto const bytes = Schema::field(Schema::BYTES);
+    if (index_+1 < field_.size() && field_[index_] == varint && field_[index_+1] == bytes) {
+        index_ += 2;
+        in_->val(in);
+    } else {
+        skip();
+        skip();
+    }
+}
+
+void SchemaReadFunctor::valVarint(uint64_t& in) {
+    if (index_ < field_.size() && field_[index_] == Schema::field(Schema::VARINT)) {
+        ++index_;
+        in_->valVarint(in);
+        length_ = in;
+    } else {
+        skip();
+    }
+}
+
+void SchemaReadFunctor::valPacked(char* buf, size_t len, uint32_t const* end, size_t fields) {
+// Fields in a packed run are matched one by one
+    auto begin = uint32_t(0);
+    for (size_t i = 0; i < fields; ++i) {
+        val(buf+begin, end[i]-begin);
+        begin = end[i];
+    }
+}
+
+void SchemaReadFunctor::finish() {
+    while (index_ < field_.size()) {
+        skip();
+    }
+}
+
+void SchemaReadFunctor::skip() {
+// Read and drop the peer's next field, if any.  A string (a VARINT followed
+// by BYTES) is read whole by the underlying functor.
+    if (index_ >= field_.size()) {
+        return;
+    }
+    auto const field = field_[index_++];
+    auto const next = index_ < field_.size() ? field_[index_] : Schema::field(Schema::FIXED);
+    if (Schema::kind(field) == Schema::VARINT && Schema::kind(next) == Schema::BYTES) {
+        auto value = std::string();
+        in_->val(value);
+        ++index_;
+    } else if (Schema::kind(field) == Schema::VARINT) {
+        in_->valVarint(length_);
+    } else {
+        auto const len = Schema::kind(field) == Schema::FIXED ? uint64_t(Schema::len(field)) : length_;
+        if (len > MAX_STRING_SIZE) {
+            throw coro::SocketCloseException();
+        }
+        scratch_.resize(size_t(std::min(len, uint64_t(MAX_SKIP))));
+        auto left = size_t(len);
+        while (left > 0) {
+            auto const chunk = std::min(left, scratch_.size());
+            in_->val(&scratch_.front(), chunk);
+            left -= chunk;
+        }
+    }
+}
+
+static Ptr<Schema> schemaFor(Model& model) {
+// Returns the schema of the model's type, building it from the model the
+// first time the type is seen.  The type name is the compiler's, so peers
+// built with different compilers don't recognize each other's types, and
+// refuse each other's messages for them.
+    static std::unordered_map<std::type_index, Ptr<Schema>> cache;
+    auto const type = std::type_index(typeid(model));
+    auto entry = cache.find(type);
+    if (entry != cache.end()) {
+        return entry->second;
+    }
+    auto schema = std::make_shared<Schema>();
+    schema->type = std::string(type.name());
+    model.construct(std::make_shared<SchemaFunctor>(schema->constructed));
+    model.visit(std::make_shared<SchemaFunctor>(schema->serialized));
+    schema->hashIs();
+    cache[type] = schema;
+    return schema;
+}
+
+Ptr<Schema const> schema(Model& model) {
+    return schemaFor(model);
+}
+
+static void collectSchemas(Ptr<Table> db, Ptr<SchemaList> list) {
+    for (auto& entry : *db) {
+        if (auto table = entry.second.cast<Table>()) {
+            collectSchemas(table, list);
+        } else if (auto model = entry.second.cast<Model>()) {
+            auto schema = schemaFor(*model);
+            auto& all = list->schema;
+            if (std::find(all.begin(), all.end(), schema) == all.end()) {
+                all.push_back(schema);
+            }
+        }
+    }
+}
+
+Ptr<SchemaList> schemaList(Ptr<Table> db) {
+// Returns the schemas of the model types in the database, to send to the
+// peer in the handshake.  Types without a model yet aren't included; those
+// are described in-band before they are first sent.
+    auto list = std::make_shared<SchemaList>();
+    collectSchemas(db, list);
+    return list;
+}
+
+}
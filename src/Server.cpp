@@ -25,11 +25,31 @@
 #include <jet2/Network.hpp>
 #include <jet2/Table.hpp>
 #include <jet2/Kernel.hpp>
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#endif
 
 #define log(msg) std::cerr << msg << std::endl;
 
 namespace jet2 {
 
+static std::string peerHost(coro::Socket& sd) {
+// Returns the address of the socket's peer, or an empty string if unknown
+    sockaddr_storage addr;
+    auto len = socklen_t(sizeof(addr));
+    char host[INET6_ADDRSTRLEN] = "";
+    if (getpeername(sd.fileno(), (sockaddr*)&addr, &len) != 0) {
+        return std::string();
+    } else if (addr.ss_family == AF_INET) {
+        inet_ntop(AF_INET, &((sockaddr_in*)&addr)->sin_addr, host, sizeof(host));
+    } else if (addr.ss_family == AF_INET6) {
+        inet_ntop(AF_INET6, &((sockaddr_in6*)&addr)->sin6_addr, host, sizeof(host));
+    }
+    return host;
+}
+
 static void close(WeakPtr<Server> server, ClientId playerId) {
     log("error: connection closed");
     if (auto srv = server.lock()) {
@@ -38,9 +58,17 @@ static void close(WeakPtr<Server> server, ClientId playerId) {
     }
 }
 
-static void send(WeakPtr<Server> server, Ptr<Connection> conn, ClientId playerId, Ptr<Table> db) {
+static void send(WeakPtr<Server> server, Ptr<Connection> conn, ClientId playerId, Ptr<Table> db, Ptr<coro::Event> frame) {
+// Send frames to the player, either on the player's own timer, or when the
+// server has finished encoding a frame.
     try {
-        send(conn, db);
+        if (!frame) {
+            send(conn, db);
+        }
+        for (;;) {
+            frame->wait();
+            sendFrame(conn, db);
+        }
     } catch (coro::SocketCloseException const&){
         close(server, playerId);
     }
@@ -54,28 +82,32 @@ static void recv(WeakPtr<Server> server, Ptr<Connection> conn, ClientId playerId
     }
 }
 
-static void benchmark(Ptr<Connection> conn, Ptr<Table> db) {
-// Respond to ping requests & update network info.  FixMe: Prevent from leaking...
-    auto in = db->objectIs<NetworkInfo>("input/netinfo");
-    auto out = db->objectIs<NetworkInfo>("models/netinfo");
-
-    in->netMode = Model::INPUT;
-    out->netMode = Model::OUTPUT;
-	try {
-		for (;;) {
-			std::cout << "waiting" << std::endl;
-			in->wait();
-			out->pingId = in->pingId();
-			out->syncMode = Model::ONCE;
-			sendMessage(conn, out);
-			conn->writer()->flush();
-			std::cout << "ping" << std::endl;
-		}
-	} catch (coro::SocketCloseException const&) {
-	} catch (coro::ExitException const&) {
-		std::cerr << "exit" << std::endl;
-	}
-	std::cerr << "goodbye" << std::endl;
+static void recvUdp(WeakPtr<Server> server, Ptr<Connection> conn, ClientId playerId, Ptr<Table> db) {
+    try {
+        recvDatagram(conn, db);
+    } catch (coro::SocketCloseException const&){
+        close(server, playerId);
+    }
+}
+
+static void encode(WeakPtr<Server> server, Ptr<Table> db) {
+// Encode the models that changed since the last frame on the worker pool,
+// then wake the players' send coroutines, which send the cached snapshots.
+// The simulation doesn't run while the pool is busy, so the workers see a
+// consistent frame.
+    auto mt = modelTable(db);
+    auto dirty = std::make_shared<DirtySet>();
+    mt->dirtySetIs(dirty);
+    for (;;) {
+        if (auto srv = server.lock()) {
+            mt->snapshotIs(dirty->drain(), *srv->workers());
+            dirty->drainDeleted(); // Deleted models have nothing to encode
+            srv->frame()->notifyAll();
+        } else {
+            return; // Server died
+        }
+        coro::sleep(netTimestep);
+    }
 }
 
 static void accept(Ptr<Server> server, Ptr<Connection> conn, Ptr<Table> db) {
@@ -88,16 +120,49 @@ static void accept(Ptr<Server> server, Ptr<Connection> conn, Ptr<Table> db) {
 
     clientDesc->magic = 0;
     try {
+        // The client sends its descriptor first, so that the server can
+        // accept or decline UDP and compression in its reply.  Each side
+        // follows its descriptor with the schemas of its model types.  A
+        // client that speaks another version gets the server's descriptor,
+        // so that it can tell why, and nothing else.
+        conn->in()->val(clientDesc);
+        auto const known = clientDesc->magic() == jet2::MAGIC && clientDesc->version() == NET_VERSION;
+        if (known) {
+            recvSchemas(conn);
+        }
+        auto const valid = known && clientDesc->clientId() < server->maxPlayers();
+        auto const peer = peerHost(*conn->sd());
+        if (valid && clientDesc->udpPort() && clientDesc->clientId() < MAX_UDP_CLIENTS && !peer.empty()) {
+            // Datagrams go to the address the client connected from
+            serverDesc->udpPort = serverUdpPort(server->port(), clientDesc->clientId());
+            conn->udp = datagramSocket(serverDesc->udpPort(), server->host());
+            conn->udp()->connect(coro::SocketAddr(peer, clientDesc->udpPort()));
+        }
+        serverDesc->compress = valid && clientDesc->compress() && server->compress();
         conn->out()->val(serverDesc);
+        if (known) {
+            sendSchemas(conn, db);
+        }
         conn->writer()->flush();
-        conn->in()->val(clientDesc);
+        conn->compress = serverDesc->compress();
     } catch (coro::SocketCloseException const&) {
         log("error: connection closed");
+        conn->sd()->close();
+        return;
+    } catch (std::exception const& ex) {
+        log("error: handshake failed: " << ex.what());
+        conn->sd()->close();
         return;
     }
     if (clientDesc->magic() != jet2::MAGIC) {
         log("error: invalid magic number: " << (uint32_t)clientDesc->magic());
-        return; // Close connection
+        conn->sd()->close();
+        return;
+    }
+    if (clientDesc->version() != NET_VERSION) {
+        log("error: unsupported version: " << (uint32_t)clientDesc->version());
+        conn->sd()->close();
+        return;
     }
     if (clientDesc->clientId() >= server->maxPlayers()) {
         log("error: invalid client id: " << (uint32_t)clientDesc->clientId());
@@ -111,29 +176,42 @@ static void accept(Ptr<Server> server, Ptr<Connection> conn, Ptr<Table> db) {
     auto weakServer = WeakPtr<Server>(server);
     auto player = std::make_shared<Player>();
     auto id = clientDesc->clientId();
+    auto frame = server->workers() ? server->frame() : Ptr<coro::Event>();
 
+    conn->relevance = server->relevance();
+    conn->maxUnsent = server->maxUnsent();
     player->conn = conn;
     player->id = clientDesc->clientId();
-    player->benchmark = coro::start([=]{ benchmark(conn, db); });
-    player->send = coro::start([=]{ send(weakServer, conn, id, models); }); 
+    player->send = coro::start([=]{ send(weakServer, conn, id, models, frame); }); 
     player->recv = coro::start([=]{ recv(weakServer, conn, id, input); }); 
+    if (conn->udp()) {
+        player->recvUdp = coro::start([=]{ recvUdp(weakServer, conn, id, input); });
+    }
     server->player(player->id(), player); 
     server->event()->notifyAll();
     // Create a new player and add it to the server datastructure
 }
 
-Ptr<Server> server(Ptr<Table> db, size_t players) {
-// Process incoming client connections
-    auto port = uint16_t(9090);
+Ptr<Server> server(Ptr<Table> db, size_t players, size_t workers, uint16_t port, std::string const& host) {
+// Process incoming client connections on the local address 'host'.  If
+// 'workers' is nonzero, a pool of that many threads encodes each frame's
+// models in parallel.
     auto ls = std::make_shared<coro::Socket>();
     ls->setsockopt(SOL_SOCKET, SO_REUSEADDR, 1);
-    ls->bind(coro::SocketAddr("127.0.0.1", port));
-    ls->listen(16);  
-    log("info: listening on port " << port);
+    ls->bind(coro::SocketAddr(host, port));
+    ls->listen(SOMAXCONN); // Many clients may connect at once
+    log("info: listening on " << host << ":" << port);
 
     auto server = std::make_shared<Server>();
     auto weak = WeakPtr<Server>(server);
     server->maxPlayers = players;
+    server->port = port;
+    server->host = host;
+    if (workers) {
+        auto models = db->objectIs<Table>("models");
+        server->workers = std::make_shared<WorkerPool>(workers);
+        server->encode = coro::start([=]{ encode(weak, models); });
+    }
     server->accept = coro::start([=]{
         for (;;) {
             auto self = coro::current();
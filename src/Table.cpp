@@ -47,6 +47,61 @@ TableException::TableException(std::string const& message) {
     // unrecoverable missing resource).   However, this behavior can be changed
     // via the above environment variable.
 }
+
+static std::unordered_map<std::string, ModelFactory>& modelFactories() {
+    static std::unordered_map<std::string, ModelFactory> factories;
+    return factories;
+}
+
+void modelFactoryIs(std::string const& type, ModelFactory const& factory) {
+    modelFactories()[type] = factory;
+}
+
+ModelFactory modelFactory(std::string const& type) {
+// Returns the factory for the type, or an empty function if none is registered
+    auto entry = modelFactories().find(type);
+    return entry == modelFactories().end() ? ModelFactory() : entry->second;
+}
+
+void Table::objectDel(char const* path) {
+    // Removes the object at the given path, if it exists.  Models beneath the
+    // object are removed from the registry.
+    auto ptr = strchr(path, '/');
+    assert(*path != '\0'); // String is empty
+    assert(ptr != path); // String starts with a '/'
+
+    if (ptr) {
+        auto len = ptr - path;
+        auto ent = object_.find(std::string(path, len));
+        if (ent == object_.end()) {
+            return;
+        }
+        if (auto table = ent->second.cast<Table>()) {
+            table->objectDel(ptr+1);
+        }
+    } else {
+        auto ent = object_.find(std::string(path));
+        if (ent == object_.end()) {
+            return;
+        }
+        unregisterObject(ent->second);
+        object_.erase(ent);
+    }
+}
+
+void Table::unregisterObject(TableEntry& entry) {
+    // Removes the model (or all models in the table) from the registry
+    if (!registry_) {
+        return;
+    } else if (auto table = entry.cast<Table>()) {
+        for (auto& child : *table) {
+            table->unregisterObject(child.second);
+        }
+    } else if (auto model = entry.cast<Model>()) {
+        registry_->modelDel(model->id());
+    }
+}
+
 }
 
 
@@ -23,6 +23,7 @@
 #include "jet2/Common.hpp"
 #include "jet2/View.hpp"
 #include "jet2/Functions.hpp"
+#include "jet2/Interpolator.hpp"
 #include "jet2/Kernel.hpp"
 
 namespace jet2 {
@@ -41,8 +42,16 @@ View::~View() {
 }
 
 void View::tick() {
-    node_->positionIs(model_->position());
-    node_->rotationIs(model_->rotation());
+// Draw remote models at renderTick(), interpolated from the states received,
+// so that they move smoothly between network updates.  Local models (and
+// remote models with no history yet) are drawn at their current state.
+    auto position = model_->position();
+    auto rotation = model_->rotation();
+    if (auto history = model_->history()) {
+        history->sample(renderTick(), position, rotation);
+    }
+    node_->positionIs(position);
+    node_->rotationIs(rotation);
 }
 
 void View::render() {
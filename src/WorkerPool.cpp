@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "jet2/Common.hpp"
+#include "jet2/WorkerPool.hpp"
+
+namespace jet2 {
+
+WorkerPool::WorkerPool(size_t threads) {
+    for (size_t i = 0; i < threads; ++i) {
+        thread_.push_back(std::thread([this] { work(); }));
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        exit_ = true;
+    }
+    workAvailable_.notify_all();
+    for (auto& thread : thread_) {
+        thread.join();
+    }
+}
+
+void WorkerPool::run(size_t count, Task const& task) {
+// Run the tasks on the pool, and wait for all of them to finish.  The calling
+// thread runs tasks too, so a pool with no threads runs them inline.
+    if (count == 0) {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        task_ = &task;
+        count_ = count;
+        next_ = 0;
+        done_ = 0;
+        ++batch_;
+    }
+    workAvailable_.notify_all();
+
+    auto index = size_t(0);
+    while (next(batch_, index)) {
+        task(index);
+        std::unique_lock<std::mutex> lock(mutex_);
+        ++done_;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    workDone_.wait(lock, [this] { return done_ == count_; });
+    task_ = nullptr;
+}
+
+bool WorkerPool::next(uint64_t batch, size_t& index) {
+// Claim the next task in 'batch', if it is still the current batch and any
+// tasks are left
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!task_ || batch != batch_ || next_ == count_) {
+        return false;
+    }
+    index = next_++;
+    return true;
+}
+
+void WorkerPool::work() {
+// Wait for a batch, then run tasks from it until none are left
+    auto batch = uint64_t(0);
+    for (;;) {
+        Task const* task = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            workAvailable_.wait(lock, [&] { return exit_ || (batch_ != batch && task_); });
+            if (exit_) {
+                return;
+            }
+            batch = batch_;
+            task = task_;
+        }
+        auto index = size_t(0);
+        while (next(batch, index)) {
+            (*task)(index);
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (++done_ == count_) {
+                workDone_.notify_all();
+            }
+        }
+    }
+}
+
+}
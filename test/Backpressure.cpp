@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "jet2/Common.hpp"
+#include "jet2/jet2.hpp"
+
+template <typename T>
+using Ptr = jet2::Ptr<T>;
+
+// Checks that a server sending to a peer that stops reading skips frames
+// instead of queueing them, and that the peer still ends up with the latest
+// state once it starts reading again.
+
+int const SHIPS = 200;
+int const FRAMES = 100;
+size_t const MAX_UNSENT = 16*1024;
+uint16_t const PORT = 9104;
+
+class Ship : public jet2::Model {
+public:
+    SERIALIZED(position);
+};
+
+void setup(Ptr<jet2::Table> db, jet2::Model::NetMode mode) {
+    for (auto i = 0; i < SHIPS; ++i) {
+        auto ship = db->objectIs<Ship>(jet2::format("ship%d", i));
+        ship->syncMode = jet2::Model::CHANGED;
+        ship->netMode = mode;
+    }
+}
+
+void move(Ptr<jet2::Table> db, int frame) {
+    for (auto i = 0; i < SHIPS; ++i) {
+        auto ship = db->object<Ship>(jet2::format("ship%d", i));
+        ship->position = sfr::Vector(float(frame), float(i), 0);
+    }
+}
+
+void server() {
+    try {
+        auto ls = std::make_shared<coro::Socket>();
+        ls->setsockopt(SOL_SOCKET, SO_REUSEADDR, 1);
+        ls->bind(coro::SocketAddr("127.0.0.1", PORT));
+        ls->listen(10);
+
+        auto sd = ls->accept();
+        auto db = std::make_shared<jet2::Table>();
+        auto conn = std::make_shared<jet2::Connection>(sd);
+        conn->maxUnsent = MAX_UNSENT;
+        setup(db, jet2::Model::OUTPUT);
+
+        for (auto frame = 0; frame < FRAMES; ++frame) {
+            move(db, frame);
+            sendFrame(conn, db);
+            coro::sleep(coro::Time::millisec(1));
+        }
+        std::cout << "skipped: " << conn->framesSkipped() << " of " << FRAMES << std::endl;
+        assert(conn->framesSkipped() > 0);
+
+        // Wait for the peer to catch up, so that the last frame goes out
+        for (;;) {
+            auto const skipped = conn->framesSkipped();
+            sendFrame(conn, db);
+            if (conn->framesSkipped() == skipped) {
+                break;
+            }
+            coro::sleep(coro::Time::millisec(10));
+        }
+        sd->close();
+    } catch (coro::SystemError const& ex) {
+        std::cout << ex.what() << std::endl;
+        exit(1);
+    }
+}
+
+void client() {
+    auto sd = std::make_shared<coro::Socket>();
+    auto db = std::make_shared<jet2::Table>();
+    auto conn = std::make_shared<jet2::Connection>(sd);
+    setup(db, jet2::Model::INPUT);
+    try {
+        sd->setsockopt(SOL_SOCKET, SO_RCVBUF, 4096); // Back up the server quickly
+        sd->connect(coro::SocketAddr("127.0.0.1", PORT));
+        coro::sleep(coro::Time::millisec(200)); // Stall while the server sends
+        for (;;) {
+            recvFrame(conn, db);
+        }
+    } catch (coro::SocketCloseException const&) {
+    } catch (coro::SystemError const& ex) {
+        std::cout << ex.what() << std::endl;
+        exit(1);
+    }
+
+    auto expected = std::make_shared<jet2::Table>();
+    setup(expected, jet2::Model::INPUT);
+    move(expected, FRAMES-1);
+    for (auto i = 0; i < SHIPS; ++i) {
+        auto name = jet2::format("ship%d", i);
+        assert(db->object<Ship>(name)->position() == expected->object<Ship>(name)->position());
+    }
+}
+
+int main() {
+    auto serverc = coro::start(server);
+    auto clientc = coro::start(client);
+    coro::run();
+    return 0;
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2013 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "jet2/Common.hpp"
+#include "jet2/Compress.hpp"
+
+using namespace jet2;
+
+void roundtrip(Compressor& compressor, Decompressor& decompressor, std::vector<char> const& frame) {
+    auto out = std::vector<char>();
+    compressor.compress(frame.data(), frame.size(), out);
+    assert(decompressor.decompress(out.data(), out.size(), frame.size()));
+    assert(decompressor.size() == frame.size());
+    assert(frame.empty() || !memcmp(decompressor.data(), frame.data(), frame.size()));
+}
+
+int main() {
+    auto compressor = Compressor();
+    auto decompressor = Decompressor();
+    auto frame = std::vector<char>(4096);
+    auto seed = uint32_t(1);
+    auto random = [&] { seed = seed*1103515245+12345; return char(seed >> 16); };
+
+    for (auto& ch : frame) {
+        ch = random();
+    }
+    roundtrip(compressor, decompressor, frame);
+
+    // Each frame differs from the last in a few bytes, so it should compress
+    // well against the dictionary.
+    auto const before = compressor.bytesOut();
+    for (auto i = 0; i < 10; ++i) {
+        frame[(i*397) % frame.size()] = random();
+        roundtrip(compressor, decompressor, frame);
+    }
+    assert(compressor.bytesOut()-before < frame.size());
+
+    roundtrip(compressor, decompressor, std::vector<char>()); // Empty frame
+    auto noise = std::vector<char>(100000);
+    for (auto& ch : noise) {
+        ch = random();
+    }
+    roundtrip(compressor, decompressor, noise); // Incompressible
+    roundtrip(compressor, decompressor, frame);
+
+    // The hash table outlives each frame, so check that matches never reach
+    // past the dictionary, even for frames shorter than a match.
+    for (auto i = 0; i < 200; ++i) {
+        auto small = std::vector<char>(frame.begin(), frame.begin()+(i*37) % 9);
+        roundtrip(compressor, decompressor, small);
+    }
+    roundtrip(compressor, decompressor, frame);
+    auto const repeat = compressor.bytesOut();
+    roundtrip(compressor, decompressor, frame);
+    assert(compressor.bytesOut()-repeat < frame.size()/16);
+
+    auto out = std::vector<char>();
+    Compressor().compress(frame.data(), frame.size(), out);
+    assert(!Decompressor().decompress(out.data(), out.size(), frame.size()-1)); // Longer than claimed
+    out.resize(out.size()/2);
+    assert(!Decompressor().decompress(out.data(), out.size(), frame.size())); // Truncated
+    std::cout << "pass" << std::endl;
+    return 0;
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2013 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "jet2/Common.hpp"
+#include "jet2/jet2.hpp"
+
+template <typename T>
+using Ptr = jet2::Ptr<T>;
+
+// Checks that SYNC updates go over the unreliable channel once a model is
+// constructed, and that a message's datagram goes out with the message, not
+// with the next frame.
+
+uint16_t const PORT = 9106;
+uint16_t const SERVER_UDP_PORT = 9107;
+uint16_t const CLIENT_UDP_PORT = 9108;
+
+class Ship : public jet2::Model {
+public:
+    jet2::Attr<std::string> type;
+    CONSTRUCT(type);
+    SERIALIZED(position);
+};
+
+void setup(Ptr<jet2::Table> db, jet2::Model::NetMode mode) {
+    auto ship = db->objectIs<Ship>("ship1");
+    ship->syncMode = jet2::Model::CHANGED;
+    ship->netMode = mode;
+}
+
+bool done = false;
+
+void server(Ptr<coro::Event> event) {
+    try {
+        auto ls = std::make_shared<coro::Socket>();
+        ls->setsockopt(SOL_SOCKET, SO_REUSEADDR, 1);
+        ls->bind(coro::SocketAddr("127.0.0.1", PORT));
+        ls->listen(10);
+
+        auto sd = ls->accept();
+        auto db = std::make_shared<jet2::Table>();
+        auto conn = std::make_shared<jet2::Connection>(sd);
+        conn->udp = jet2::datagramSocket(SERVER_UDP_PORT);
+        conn->udp()->connect(coro::SocketAddr("127.0.0.1", CLIENT_UDP_PORT));
+        setup(db, jet2::Model::OUTPUT);
+
+        auto ship = db->object<Ship>("ship1");
+        ship->position = sfr::Vector(1, 1, 1);
+        sendFrame(conn, db); // CONSTRUCT, over TCP
+        assert(conn->udpBytes() == 0);
+
+        ship->position = sfr::Vector(2, 2, 2);
+        sendFrame(conn, db); // SYNC, in a datagram
+        assert(conn->udpBytes() > 0);
+
+        auto const bytes = conn->udpBytes();
+        ship->position = sfr::Vector(3, 3, 3);
+        sendMessage(conn, ship); // SYNC, in a datagram of its own
+        assert(conn->udpBytes() > bytes);
+
+        while (!done) {
+            event->wait();
+        }
+        conn->udp()->close();
+        sd->close();
+    } catch (coro::SystemError const& ex) {
+        std::cout << ex.what() << std::endl;
+        exit(1);
+    }
+}
+
+void client(Ptr<coro::Event> event) {
+    try {
+        auto sd = std::make_shared<coro::Socket>();
+        auto db = std::make_shared<jet2::Table>();
+        auto conn = std::make_shared<jet2::Connection>(sd);
+        conn->udp = jet2::datagramSocket(CLIENT_UDP_PORT);
+        conn->udp()->connect(coro::SocketAddr("127.0.0.1", SERVER_UDP_PORT));
+        sd->connect(coro::SocketAddr("127.0.0.1", PORT));
+        setup(db, jet2::Model::INPUT);
+
+        auto ship = db->object<Ship>("ship1");
+        auto udp = coro::start([=] {
+            try {
+                recvDatagram(conn, db);
+            } catch (coro::SocketCloseException const&) {
+            }
+        });
+        recvFrame(conn, db);
+        recvFrame(conn, db);
+        while (!(ship->position() == sfr::Vector(3, 3, 3))) {
+            ship->wait(); // Only the datagram sent with the message has it
+        }
+        done = true;
+        event->notifyAll();
+        conn->udp()->close();
+        std::cout << "pass" << std::endl;
+    } catch (coro::SystemError const& ex) {
+        std::cout << ex.what() << std::endl;
+        exit(1);
+    }
+}
+
+int main() {
+    auto event = std::make_shared<coro::Event>();
+    auto cserver = coro::start([&] { server(event); });
+    auto cclient = coro::start([&] { client(event); });
+    coro::run();
+    return 0;
+}
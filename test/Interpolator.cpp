@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "jet2/Common.hpp"
+#include "jet2/Interpolator.hpp"
+
+using namespace jet2;
+
+bool near(float a, float b, float epsilon) {
+    return std::abs(a-b) <= epsilon;
+}
+
+int main() {
+    auto history = Interpolator();
+    auto position = sfr::Vector();
+    auto rotation = sfr::Quaternion();
+    assert(!history.sample(0, position, rotation));
+
+    auto const identity = sfr::Quaternion(1, 0, 0, 0);
+    auto const turned = sfr::Quaternion(0, 0, 1, 0); // 180 degrees about y
+    history.sampleIs(10, sfr::Vector(0, 0, 0), identity);
+    history.sampleIs(16, sfr::Vector(6, 0, 0), turned);
+
+    assert(history.sample(13, position, rotation));
+    assert(near(position.x, 3, 1e-5f));
+    assert(near(rotation.w, rotation.y, 1e-5f)); // Halfway
+
+    history.sample(4, position, rotation); // Before the oldest: clamped
+    assert(near(position.x, 0, 1e-5f));
+    history.sample(40, position, rotation); // After the newest: clamped
+    assert(near(position.x, 6, 1e-5f));
+
+    history.sampleIs(16, sfr::Vector(8, 0, 0), turned); // Replaces tick 16
+    history.sampleIs(12, sfr::Vector(-1, 0, 0), turned); // Out of order: dropped
+    assert(history.samples() == 2);
+    history.sample(16, position, rotation);
+    assert(near(position.x, 8, 1e-5f));
+
+    for (auto tick = TickId(17); tick < 17+Interpolator::CAPACITY; ++tick) {
+        history.sampleIs(tick, sfr::Vector(float(tick), 0, 0), identity);
+    }
+    assert(history.samples() == Interpolator::CAPACITY);
+    history.sample(0, position, rotation); // Oldest samples were overwritten
+    assert(near(position.x, 17, 1e-5f));
+    return 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "jet2/Common.hpp"
+#include "jet2/Table.hpp"
+#include "jet2/Model.hpp"
+#include "jet2/Kernel.hpp"
+
+using namespace jet2;
+
+// Checks that deleted models free their slots for reuse with a new
+// generation, that stale ids don't resolve, and that deletions are reported
+// to dirty sets in order.  Also checks that models that exist before the
+// registry are assigned ids in path order, that writing the value an attr
+// already has doesn't mark its model dirty, and that model types can be
+// created by name.
+
+class Ship : public Model {
+public:
+    SERIALIZED(position);
+};
+
+int main() {
+    auto db = std::make_shared<Table>();
+    auto mt = db->objectIs<ModelTable>("mt");
+    db->registryIs(mt);
+    auto dirty = std::make_shared<DirtySet>();
+    mt->dirtySetIs(dirty);
+
+    auto a = db->objectIs<Model>("models/a");
+    auto b = db->objectIs<Model>("models/b");
+    auto c = db->objectIs<Model>("models/c");
+    assert(a->id() == 1 && b->id() == 2 && c->id() == 3);
+    assert(mt->models() == 3 && mt->size() == 4);
+    dirty->drain();
+
+    auto const staleB = b->id();
+    auto const staleA = a->id();
+    db->objectDel("models/b");
+    mt->objectDel(staleA); // As when the peer sends REMOVE
+    assert(!db->object<Model>("models/a") && !db->object<Model>("models/b"));
+    assert(!mt->model(staleA) && !mt->model(staleB));
+    assert(mt->models() == 1);
+    auto const deleted = dirty->drainDeleted();
+    assert(deleted.size() == 2 && deleted[0] == staleB && deleted[1] == staleA);
+    assert(dirty->drainDeleted().empty());
+
+    // The most recently freed slot is reused first, with the next generation
+    auto d = db->objectIs<Model>("models/d");
+    auto e = db->objectIs<Model>("models/e");
+    assert(modelIndex(d->id()) == modelIndex(staleA) && modelGeneration(d->id()) == 1);
+    assert(modelIndex(e->id()) == modelIndex(staleB) && modelGeneration(e->id()) == 1);
+    assert(mt->model(d->id()) == d && !mt->model(staleA));
+    assert(mt->size() == 4 && mt->models() == 3);
+
+    // A slot queued for a deleted model is queued again for its replacement
+    auto const& queued = dirty->drain();
+    assert(std::find(queued.begin(), queued.end(), d->id()) != queued.end());
+    assert(std::find(queued.begin(), queued.end(), e->id()) != queued.end());
+
+    // Input models are deleted locally without telling the peer
+    d->netMode = Model::INPUT;
+    mt->objectDel(d->id());
+    assert(dirty->drainDeleted().empty() && mt->models() == 2);
+    assert(mt->path(e->id()) == "models/e" && mt->path(d->id()).empty());
+    assert(mt->path(modelId(1000, 0)).empty() && !mt->model(modelId(1000, 0))); // Never allocated
+
+    auto other = std::make_shared<Table>();
+    auto z = other->objectIs<Model>("z");
+    auto y = other->objectIs<Model>("units/y");
+    auto x = other->objectIs<Model>("units/x");
+    auto omt = modelTable(other);
+    assert(x->id() == 1 && y->id() == 2 && z->id() == 3);
+    auto w = other->objectIs<Model>("units/w"); // Registered as it's created
+    assert(w->id() == 4 && omt->model(4) == w && omt->path(4) == "units/w");
+
+    auto ship = db->objectIs<Ship>("models/ship");
+    ship->position = sfr::Vector(1, 0, 0);
+    dirty->drain();
+    ship->position = sfr::Vector(1, 0, 0); // Unchanged
+    assert(dirty->drain().empty());
+    ship->position = sfr::Vector(2, 0, 0);
+    assert(dirty->drain().size() == 1);
+
+    // Creating a model registers a factory for its type, for spawning
+    auto factory = modelFactory(typeid(Ship).name());
+    auto spawned = factory(*db, "fleet/ship");
+    assert(db->object<Ship>("fleet/ship") == spawned && mt->model(spawned->id()) == spawned);
+    assert(mt->path(spawned->id()) == "fleet/ship");
+    assert(!modelFactory("unknown"));
+    return 0;
+}
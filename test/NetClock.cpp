@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "jet2/Common.hpp"
+#include "jet2/Kernel.hpp"
+#include "jet2/NetClock.hpp"
+
+using namespace jet2;
+
+bool near(double a, double b, double epsilon) {
+    return std::abs(a-b) <= epsilon;
+}
+
+int main() {
+    // The server's clock is 5 s ahead of the client's, each way takes 20 ms,
+    // and the server holds each frame for 3 ms before replying.  A round trip
+    // starts every 6 ticks, and the server replies a quarter tick after it
+    // ticks.
+    auto const skew = NetTime(5000000);
+    auto const latency = NetTime(20000);
+    auto const tickLen = NetTime(timestep.microsec());
+    auto client = NetClock();
+    auto server = NetClock();
+    auto sent = NetTime(0);
+    auto echo = NetTime(0);
+    auto hold = uint32_t(0);
+    auto phase = uint32_t(0);
+    auto local = NetTime(1000000); // Client clock
+    auto serverSent = NetTime(0); // Client clock when the server last replied
+    for (auto i = 0; i < 50; ++i) {
+        client.sendIs(sent, echo, hold, phase, local);
+        local += latency;
+        server.recvIs(tickId, sent, echo, hold, phase, local+skew);
+        local += 3000;
+        tickTime = local+skew-tickLen/4;
+        serverSent = local;
+        server.sendIs(sent, echo, hold, phase, local+skew);
+        local += latency;
+        client.recvIs(TickId(1000+6*i), sent, echo, hold, phase, local);
+        local += 6*tickLen-2*latency-3000;
+    }
+    assert(client.samples() == 50);
+    assert(server.samples() == 49);
+    assert(near(client.rtt(), 2*latency, 1));
+    assert(near(client.jitter(), 0, 1e-3*latency));
+    assert(near(client.offset(), double(skew), 1));
+    assert(near(server.rtt(), 2*latency, 1));
+    assert(near(server.offset(), -double(skew), 1));
+
+    // The client maps its clock to the server's ticks
+    assert(near(client.peerTick(serverSent), 1000+6*49+.25, 0.01));
+    assert(near(client.peerTick(serverSent+tickLen), 1000+6*49+1.25, 0.01));
+    assert(!client.due(local));
+    assert(client.due(local+NetClock::INTERVAL));
+    return 0;
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "jet2/Common.hpp"
+#include "jet2/jet2.hpp"
+
+template <typename T>
+using Ptr = jet2::Ptr<T>;
+
+// Replicates a moving scene through a simulated link whose conditions worsen
+// partway through, and checks that the client ends up with the server's
+// state.  Then sends datagrams through a lossy, reordering link, and checks
+// that the losses and reordering are what the sim reports.
+
+int const SHIPS = 50;
+int const FRAMES = 20;
+int const DATAGRAMS = 200;
+uint16_t const SERVER_PORT = 9097;
+uint16_t const SIM_PORT = 9098;
+
+class Ship : public jet2::Model {
+public:
+    jet2::Attr<std::string> type;
+    CONSTRUCT(type);
+    SERIALIZED(position);
+};
+
+void setup(Ptr<jet2::Table> db, jet2::Model::NetMode mode) {
+    for (auto i = 0; i < SHIPS; ++i) {
+        auto ship = db->objectIs<Ship>(jet2::format("ship%d", i));
+        ship->netMode = mode;
+    }
+}
+
+void move(Ptr<jet2::Table> db, int frame) {
+    for (auto i = 0; i < SHIPS; ++i) {
+        auto ship = db->object<Ship>(jet2::format("ship%d", i));
+        ship->position = sfr::Vector(float(frame), float(i), 0);
+    }
+}
+
+jet2::NetProfile profile() {
+    // Good at first; then a congested, lossy link
+    auto good = jet2::NetCondition();
+    good.latency = coro::Time::millisec(20);
+    good.jitter = coro::Time::millisec(5);
+    auto bad = jet2::NetCondition();
+    bad.latency = coro::Time::millisec(80);
+    bad.jitter = coro::Time::millisec(30);
+    bad.bandwidth = 32*1024;
+    bad.loss = 0.05;
+    jet2::NetStep const steps[] = {
+        { coro::Time::millisec(0), good },
+        { coro::Time::millisec(200), bad },
+    };
+    return jet2::NetProfile(steps, steps+2);
+}
+
+void server() {
+    try {
+        auto ls = std::make_shared<coro::Socket>();
+        ls->setsockopt(SOL_SOCKET, SO_REUSEADDR, 1);
+        ls->bind(coro::SocketAddr("127.0.0.1", SERVER_PORT));
+        ls->listen(10);
+
+        auto sd = ls->accept();
+        auto db = std::make_shared<jet2::Table>();
+        auto conn = std::make_shared<jet2::Connection>(sd);
+        setup(db, jet2::Model::OUTPUT);
+        for (auto frame = 0; frame < FRAMES; ++frame) {
+            move(db, frame);
+            sendFrame(conn, db);
+            coro::sleep(coro::Time::millisec(20));
+        }
+        sd->close();
+    } catch (coro::SystemError const& ex) {
+        std::cout << ex.what() << std::endl;
+        exit(1);
+    }
+}
+
+void client() {
+    auto sim = jet2::streamSim(SIM_PORT, SERVER_PORT);
+    sim->profileIs(profile());
+
+    auto sd = std::make_shared<coro::Socket>();
+    auto db = std::make_shared<jet2::Table>();
+    auto conn = std::make_shared<jet2::Connection>(sd);
+    setup(db, jet2::Model::INPUT);
+    auto const start = jet2::NetClock::now();
+    auto first = jet2::NetTime(0);
+    try {
+        sd->connect(coro::SocketAddr("127.0.0.1", SIM_PORT));
+        for (;;) {
+            recvFrame(conn, db);
+            if (!first) {
+                first = jet2::NetClock::now()-start;
+            }
+        }
+    } catch (coro::SocketCloseException const&) {
+    } catch (coro::SystemError const& ex) {
+        std::cout << ex.what() << std::endl;
+        exit(1);
+    }
+    auto const elapsed = jet2::NetClock::now()-start;
+    std::cout << "stream: " << sim->packets() << " packets, " << sim->bytes() << " bytes, ";
+    std::cout << "first frame " << first/1000 << " ms, done " << elapsed/1000 << " ms" << std::endl;
+    assert(first >= (20-5)*1000); // At least the latency, less jitter
+
+    auto expected = std::make_shared<jet2::Table>();
+    setup(expected, jet2::Model::INPUT);
+    move(expected, FRAMES-1);
+    for (auto i = 0; i < SHIPS; ++i) {
+        auto name = jet2::format("ship%d", i);
+        assert(db->object<Ship>(name)->position() == expected->object<Ship>(name)->position());
+    }
+}
+
+void datagrams() {
+    auto a = jet2::datagramSocket(9100);
+    auto b = jet2::datagramSocket(9103);
+    auto sim = jet2::datagramSim(9101, 9100, 9102, 9103);
+    a->connect(coro::SocketAddr("127.0.0.1", 9101));
+    b->connect(coro::SocketAddr("127.0.0.1", 9102));
+
+    auto lossy = jet2::NetCondition();
+    lossy.latency = coro::Time::millisec(10);
+    lossy.loss = 0.2;
+    lossy.reorder = 0.2;
+    sim->condition = lossy;
+
+    auto received = 0;
+    auto reordered = 0;
+    auto recv = coro::start([&] {
+        auto last = uint32_t(0);
+        for (;;) {
+            auto seq = uint32_t(0);
+            b->read((char*)&seq, sizeof(seq));
+            if (seq == DATAGRAMS) {
+                break;
+            }
+            reordered += (seq < last);
+            last = std::max(last, seq);
+            ++received;
+        }
+    });
+    for (auto seq = uint32_t(0); seq < DATAGRAMS; ++seq) {
+        a->write((char const*)&seq, sizeof(seq));
+    }
+    coro::sleep(coro::Time::millisec(100)); // Let the stragglers arrive
+    sim->condition = jet2::NetCondition();
+    auto const end = uint32_t(DATAGRAMS);
+    a->write((char const*)&end, sizeof(end));
+    while (received+sim->dropped() < DATAGRAMS) {
+        coro::sleep(coro::Time::millisec(10));
+    }
+
+    std::cout << "datagram: " << received << " received, " << sim->dropped() << " dropped, ";
+    std::cout << reordered << " reordered" << std::endl;
+    assert(received+sim->dropped() == DATAGRAMS);
+    assert(sim->dropped() > 0 && reordered > 0);
+}
+
+int main() {
+    auto srv = coro::start([] { server(); });
+    auto cli = coro::start([] { client(); });
+    auto dgram = coro::start([] { datagrams(); });
+    coro::run();
+    return 0;
+}
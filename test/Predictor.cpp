@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "jet2/Common.hpp"
+#include "jet2/jet2.hpp"
+
+using namespace jet2;
+
+uint16_t const PORT = 9110;
+
+class Move : public Model {
+public:
+    Attr<float> dx;
+    SERIALIZED(dx);
+};
+
+class Ship : public Model {
+public:
+    Attr<float> fuel = 0.f;
+    SERIALIZED(position, fuel);
+};
+
+void step(Ptr<Model> model, Ptr<Model> input) {
+    auto move = std::static_pointer_cast<Move>(input);
+    auto position = model->position();
+    position.x += move->dx();
+    model->position = position;
+}
+
+void server(Ptr<coro::Socket> ls) {
+    // Sends the ship in full, and then a DELTA that changes only its fuel
+    try {
+        auto sd = ls->accept();
+        auto db = std::make_shared<Table>();
+        auto ship = db->objectIs<Ship>("ship");
+        auto conn = std::make_shared<Connection>(sd);
+        ship->position = sfr::Vector(10, 0, 0);
+        sendFrame(conn, db);
+        ship->fuel = 5.f;
+        sendFrame(conn, db);
+        sd->close();
+    } catch (coro::SystemError const& ex) {
+        std::cout << ex.what() << std::endl;
+        exit(1);
+    }
+}
+
+void client() {
+    // Predicts the ship's position while receiving it.  The DELTA doesn't
+    // carry the position, so the server's position must be restored before
+    // the input is replayed; otherwise, it would be applied twice.
+    try {
+        auto sd = std::make_shared<coro::Socket>();
+        auto db = std::make_shared<Table>();
+        auto ship = db->objectIs<Ship>("ship");
+        ship->netMode = Model::INPUT;
+        auto input = std::make_shared<Move>();
+        input->dx = 1;
+        auto predictor = std::make_shared<Predictor>(ship, input, step);
+        auto conn = std::make_shared<Connection>(sd);
+        sd->connect(coro::SocketAddr("127.0.0.1", PORT));
+
+        tickId = 1;
+        recvFrame(conn, db);
+        predictor->tick();
+        assert(ship->position().x == 10+1);
+
+        tickId = 2;
+        recvFrame(conn, db);
+        assert(ship->position().x == 10 && ship->fuel() == 5.f);
+        predictor->tick();
+        assert(ship->position().x == 10+1+1);
+        sd->close();
+    } catch (coro::SystemError const& ex) {
+        std::cout << ex.what() << std::endl;
+        exit(1);
+    }
+}
+
+void delta() {
+    auto ls = std::make_shared<coro::Socket>();
+    ls->setsockopt(SOL_SOCKET, SO_REUSEADDR, 1);
+    ls->bind(coro::SocketAddr("127.0.0.1", PORT));
+    ls->listen(10);
+    auto cserver = coro::start([=] { server(ls); });
+    auto cclient = coro::start([] { client(); });
+    coro::run();
+}
+
+int main() {
+    auto model = std::make_shared<Model>();
+    auto input = std::make_shared<Move>();
+    auto predictor = std::make_shared<Predictor>(model, input, step);
+    assert(model->predicted());
+
+    // Ticks 1-5 move by 1 each, and are applied immediately
+    input->dx = 1;
+    for (tickId = 1; tickId <= 5; ++tickId) {
+        predictor->tick();
+    }
+    assert(model->position().x == 5);
+    assert(predictor->inputs() == 5);
+
+    // The server has applied ticks 1-3, but disagrees about where that leaves
+    // the model.  Ticks 4-5 are replayed on top of its state.
+    model->position = sfr::Vector(10, 0, 0);
+    model->tickAck = 3;
+    model->tickId = 5;
+    input->dx = 2;
+    predictor->tick(); // Tick 6
+    assert(predictor->inputs() == 3);
+    assert(model->position().x == 10+1+1+2);
+
+    // No new state: nothing is replayed
+    ++tickId;
+    predictor->tick(); // Tick 7
+    assert(model->position().x == 14+2);
+
+    delta();
+    return 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2013 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "jet2/Common.hpp"
+#include "jet2/Object.hpp"
+#include "jet2/Quantize.hpp"
+#include "jet2/Snapshot.hpp"
+
+using namespace jet2;
+
+class Message : public Object {
+public:
+    Attr<sfr::Vector> position;
+    Attr<sfr::Quaternion> rotation;
+    Attr<int> health;
+    SERIALIZED(quantized(position), quantized(rotation), health);
+};
+
+bool near(float a, float b, float epsilon) {
+    return std::abs(a-b) <= epsilon;
+}
+
+int main() {
+    auto bounds = QuantizeBounds(sfr::Vector(-10, -10, -10), sfr::Vector(10, 10, 10), 16);
+    auto position = sfr::Vector(1.25f, -3.5f, 9.99f);
+    char buf[16];
+    auto codec = QuantizedVector(bounds);
+    auto out = sfr::Vector();
+    assert(codec.size() == 6);
+    codec.encode(position, buf);
+    codec.decode(buf, out);
+    auto const step = 20.f/65535.f;
+    assert(near(out.x, position.x, step) && near(out.y, position.y, step) && near(out.z, position.z, step));
+
+    codec.encode(sfr::Vector(100, -100, 0), buf); // Clamped to the bounds
+    codec.decode(buf, out);
+    assert(near(out.x, 10, step) && near(out.y, -10, step));
+
+    // At the widest encoding, the top of the range is the largest value
+    auto wide = QuantizedVector(QuantizeBounds(bounds.min, bounds.max, QuantizeBounds::MAX_BITS));
+    assert(wide.size() == 9);
+    wide.encode(sfr::Vector(10, -10, 0), buf);
+    wide.decode(buf, out);
+    assert(out.x == 10 && out.y == -10);
+
+    auto rotation = sfr::Quaternion(-0.8f, 0.36f, 0.48f, 0.0f); // w, x, y, z
+    auto rcodec = QuantizedQuaternion();
+    auto rout = sfr::Quaternion();
+    rcodec.encode(rotation, buf);
+    rcodec.decode(buf, rout);
+    auto const sign = rout.w > 0 ? -1.f : 1.f; // q and -q are the same rotation
+    auto const epsilon = 0.002f;
+    assert(near(sign*rout.x, rotation.x, epsilon) && near(sign*rout.y, rotation.y, epsilon));
+    assert(near(sign*rout.z, rotation.z, epsilon) && near(sign*rout.w, rotation.w, epsilon));
+
+    auto msg = std::make_shared<Message>();
+    msg->position = position;
+    msg->rotation = rotation;
+    auto snapshot = std::make_shared<Snapshot>();
+    msg->visit(snapshot);
+    assert(snapshot->size() == 6+4+4); // vs. 12+16+4 unquantized
+    assert(msg->position() == position); // Sender's value isn't rounded
+    return 0;
+}
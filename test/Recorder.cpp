@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "jet2/Common.hpp"
+#include "jet2/jet2.hpp"
+
+template <typename T>
+using Ptr = jet2::Ptr<T>;
+
+class Ship : public jet2::Model {
+public:
+    jet2::Attr<std::string> type;
+    CONSTRUCT(type);
+    SERIALIZED(position);
+};
+
+uint16_t const PORT = 9109;
+
+void append(std::vector<char>& out, std::string const& str) {
+    char len[jet2::VARINT_MAX];
+    out.insert(out.end(), len, len+jet2::varintEncode(str.size(), len));
+    out.insert(out.end(), str.begin(), str.end());
+}
+
+std::vector<char> message(Ptr<Ship> model, jet2::ModelId id, jet2::Model::SyncFlags flags) {
+    // A SYNC or CONSTRUCT message for 'model', as it appears in a frame.  The
+    // CONSTRUCT binds 'id' to the receiver's model at "ship".
+    auto snapshot = model->snapshot();
+    auto const tag = (uint64_t(id) << jet2::MESSAGE_FLAG_BITS) | flags;
+    auto header = std::vector<char>(jet2::VARINT_MAX);
+    header.resize(jet2::varintEncode(tag, &header.front()));
+    if (flags == jet2::Model::CONSTRUCT) {
+        append(header, "ship");
+        append(header, typeid(*model).name());
+        append(header, model->type());
+    }
+    auto out = std::vector<char>(jet2::VARINT_MAX);
+    out.resize(jet2::varintEncode(header.size()+snapshot->size(), &out.front()));
+    out.insert(out.end(), header.begin(), header.end());
+    out.insert(out.end(), snapshot->data(), snapshot->data()+snapshot->size());
+    return out;
+}
+
+void server(Ptr<coro::Socket> ls) {
+    // Sends a CONSTRUCT and two updates for 'ship'; a recorder attached after
+    // the first frame is detached, since its log couldn't be replayed
+    try {
+        auto sd = ls->accept();
+        auto db = std::make_shared<jet2::Table>();
+        auto ship = db->objectIs<Ship>("ship");
+        ship->syncMode = jet2::Model::CHANGED;
+        ship->netMode = jet2::Model::OUTPUT;
+        auto conn = std::make_shared<jet2::Connection>(sd);
+        for (auto i = 1; i <= 3; ++i) {
+            ship->position = sfr::Vector(float(i), 0, 0);
+            sendFrame(conn, db);
+            if (i == 1) {
+                conn->recorder = std::make_shared<jet2::Recorder>("RecorderLate.log");
+            }
+        }
+        assert(!conn->recorder());
+        assert(conn->frames() == 3);
+        sd->close();
+    } catch (coro::SystemError const& ex) {
+        std::cout << ex.what() << std::endl;
+        exit(1);
+    }
+}
+
+void client(char const* path) {
+    // Records the frames received from the server
+    try {
+        auto sd = std::make_shared<coro::Socket>();
+        auto db = std::make_shared<jet2::Table>();
+        auto ship = db->objectIs<Ship>("ship");
+        ship->netMode = jet2::Model::INPUT;
+        auto conn = std::make_shared<jet2::Connection>(sd);
+        conn->recorder = std::make_shared<jet2::Recorder>(path);
+        sd->connect(coro::SocketAddr("127.0.0.1", PORT));
+        for (auto i = 1; i <= 3; ++i) {
+            recvFrame(conn, db);
+        }
+        assert(ship->position() == sfr::Vector(3, 0, 0));
+        assert(conn->recorder()->frames() == 3);
+        sd->close();
+    } catch (coro::SystemError const& ex) {
+        std::cout << ex.what() << std::endl;
+        exit(1);
+    }
+}
+
+void live() {
+    // Records a real connection, and replays it into a fresh table
+    auto const path = "RecorderLive.log";
+    auto ls = std::make_shared<coro::Socket>();
+    ls->setsockopt(SOL_SOCKET, SO_REUSEADDR, 1);
+    ls->bind(coro::SocketAddr("127.0.0.1", PORT));
+    ls->listen(10);
+    auto cserver = coro::start([=] { server(ls); });
+    auto cclient = coro::start([=] { client(path); });
+    coro::run();
+
+    auto db = std::make_shared<jet2::Table>();
+    auto ship = db->objectIs<Ship>("ship");
+    ship->netMode = jet2::Model::INPUT;
+    auto conn = std::make_shared<jet2::Connection>(std::make_shared<coro::Socket>());
+    jet2::replay(std::make_shared<jet2::Replay>(path), conn, db);
+    assert(ship->position() == sfr::Vector(3, 0, 0));
+}
+
+int main() {
+    auto const path = "Recorder.log";
+    auto db = std::make_shared<jet2::Table>();
+    auto ship = db->objectIs<Ship>("ship");
+    ship->netMode = jet2::Model::INPUT;
+    jet2::modelTable(db);
+    auto const id = ship->id();
+
+    {
+        // Frames for ticks 1-3 were received, and one was sent; the frame for
+        // tick 2 arrived late
+        auto recorder = std::make_shared<jet2::Recorder>(path);
+        auto source = std::make_shared<Ship>();
+        auto const ticks = { 1, 3, 2 };
+        for (auto tick : ticks) {
+            source->position = sfr::Vector(float(tick), 0, 0);
+            auto frame = message(source, id, tick == 1 ? jet2::Model::CONSTRUCT : jet2::Model::SYNC);
+            recorder->frameIs(jet2::Recorder::IN, tick, 0, 1, &frame.front(), frame.size());
+        }
+        recorder->frameIs(jet2::Recorder::OUT, 3, 3, 0, 0, 0);
+    }
+
+    auto log = std::make_shared<jet2::Replay>(path);
+    auto frame = jet2::Replay::Frame();
+    auto frames = 0;
+    while (log->next(frame)) {
+        ++frames;
+    }
+    assert(frames == 4);
+    assert(frame.dir == jet2::Recorder::OUT && frame.tick == 3 && frame.len == 0);
+
+    // Replaying applies every frame in the order it was received, as the
+    // connection did, including the late one
+    log->rewind();
+    auto conn = std::make_shared<jet2::Connection>(std::make_shared<coro::Socket>());
+    jet2::replay(log, conn, db);
+    assert(ship->position() == sfr::Vector(2, 0, 0));
+    assert(conn->tickIn() == 2);
+
+    live();
+    return 0;
+}
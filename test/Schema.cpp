@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "jet2/Common.hpp"
+#include "jet2/Model.hpp"
+#include "jet2/Reader.hpp"
+#include "jet2/Schema.hpp"
+#include "jet2/Table.hpp"
+#include "jet2/Writer.hpp"
+
+using namespace jet2;
+
+// Checks that a model can be decoded from a peer whose build encodes its type
+// differently: shared fields are read, fields only the peer has are skipped,
+// and fields only the receiver has keep their values.  A schema list over the
+// limits is rejected rather than truncated.
+
+class ShipV1 : public Model {
+public:
+    Attr<std::string> type;
+    Attr<uint32_t> health = uint32_t(0);
+    CONSTRUCT(type);
+    SERIALIZED(position, health);
+};
+
+class ShipV0 : public Model {
+// An older build, where health was narrower
+public:
+    Attr<std::string> type;
+    Attr<uint16_t> health = uint16_t(0);
+    CONSTRUCT(type);
+    SERIALIZED(position, health);
+};
+
+class ShipV2 : public Model {
+// A newer build, which added fields at the end of both lists.  Fields are
+// matched by position, so fields must be added at the end.
+public:
+    Attr<std::string> type;
+    Attr<uint32_t> health = uint32_t(0);
+    Attr<double> shield = 0.;
+    Attr<std::string> pilot;
+    Attr<int32_t> score = 0;
+    CONSTRUCT(type, score);
+    SERIALIZED(position, health, shield, pilot, varint(score));
+};
+
+std::vector<char> encode(Model& model) {
+    auto writer = std::make_shared<MemoryWriter>();
+    auto out = Ptr<Functor>(new WriteFunctor<MemoryWriter>(writer));
+    model.construct(out);
+    model.visit(out);
+    return std::vector<char>(writer->data(), writer->data()+writer->size());
+}
+
+bool rejected(std::vector<uint64_t> const& varints) {
+    // True if reading a schema list that starts with 'varints' closes the
+    // connection
+    auto buf = std::vector<char>();
+    for (auto value : varints) {
+        char out[VARINT_MAX];
+        buf.insert(buf.end(), out, out+varintEncode(value, out));
+    }
+    buf.resize(buf.size()+64);
+    auto reader = std::make_shared<MemoryReader>();
+    reader->bufferIs(&buf.front(), buf.size());
+    try {
+        std::make_shared<SchemaList>()->visit(Ptr<Functor>(new MemoryReadFunctor(reader)));
+    } catch (coro::SocketCloseException const&) {
+        return true;
+    }
+    return false;
+}
+
+void decode(std::vector<char> const& buf, Schema const& peer, Model& model) {
+    auto reader = std::make_shared<MemoryReader>();
+    reader->bufferIs(&buf.front(), buf.size());
+    auto in = Ptr<Functor>(new MemoryReadFunctor(reader));
+    auto constructed = std::make_shared<SchemaReadFunctor>(in, peer.constructed);
+    model.construct(constructed);
+    constructed->finish();
+    auto serialized = std::make_shared<SchemaReadFunctor>(in, peer.serialized);
+    model.visit(serialized);
+    serialized->finish();
+    assert(!reader->error() && reader->remaining() == 0);
+}
+
+int main() {
+    auto v1 = ShipV1();
+    auto v2 = ShipV2();
+    auto const s1 = schema(v1);
+    auto const s2 = schema(v2);
+    assert(schema(v1) == s1); // Cached by type
+    assert(s1->hash() != s2->hash());
+    assert(s1->constructed.size() == 2 && s1->serialized.size() == 4);
+    assert(s2->constructed.size() == 3 && s2->serialized.size() == 8);
+
+    // Newer peer; the extra fields are skipped
+    v2.type = std::string("frigate");
+    v2.position = sfr::Vector(1, 2, 3);
+    v2.health = 90;
+    v2.shield = 0.5;
+    v2.pilot = std::string("ace");
+    v2.score = -7;
+    decode(encode(v2), *s2, v1);
+    assert(v1.type() == "frigate" && v1.position() == sfr::Vector(1, 2, 3));
+    assert(v1.health() == 90);
+
+    // Older peer; the fields it doesn't have keep their values
+    auto older = ShipV2();
+    older.shield = 0.25;
+    older.pilot = std::string("rookie");
+    v1.health = 40;
+    decode(encode(v1), *s1, older);
+    assert(older.type() == "frigate" && older.health() == 40);
+    assert(older.shield() == 0.25 && older.pilot() == "rookie" && older.score() == 0);
+
+    // A field whose size changed is skipped, and keeps its value
+    auto oldest = ShipV0();
+    oldest.health = 10;
+    decode(encode(v1), *s1, oldest);
+    assert(oldest.type() == "frigate" && oldest.position() == sfr::Vector(1, 2, 3));
+    assert(oldest.health() == 10);
+
+    // Schemas survive the trip through the handshake
+    auto db = std::make_shared<Table>();
+    db->objectIs<ShipV1>("ships/a");
+    db->objectIs<ShipV1>("ships/b");
+    db->objectIs<ShipV2>("ships/c");
+    auto list = schemaList(db);
+    assert(list->schema.size() == 2);
+    auto writer = std::make_shared<MemoryWriter>();
+    list->visit(Ptr<Functor>(new WriteFunctor<MemoryWriter>(writer)));
+    auto reader = std::make_shared<MemoryReader>();
+    reader->bufferIs(writer->data(), writer->size());
+    auto copy = std::make_shared<SchemaList>();
+    copy->visit(Ptr<Functor>(new MemoryReadFunctor(reader)));
+    assert(!reader->error() && reader->remaining() == 0);
+    assert(copy->schema.size() == 2);
+    for (size_t i = 0; i < copy->schema.size(); ++i) {
+        auto const& a = *list->schema[i];
+        auto const& b = *copy->schema[i];
+        assert(a.type() == b.type() && a.hash() == b.hash());
+        assert(a.constructed == b.constructed && a.serialized == b.serialized);
+    }
+
+    // Counts and lengths from the peer are bounded.  A zero varint is one
+    // zero byte, so eight of them stand in for a schema's hash.
+    assert(rejected({ 1u << 20 })); // Schemas
+    assert(rejected({ 1, 1u << 30 })); // Type name length
+    assert(rejected({ 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1u << 20 })); // Fields
+    assert(!rejected({ 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }));
+    return 0;
+}
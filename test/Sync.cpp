@@ -36,7 +36,7 @@ public:
 void setup(Ptr<jet2::Table> db) {
     // Set up a sample scene (identical setup on both connection sides)
     auto ship = db->objectIs<Ship>("ship1");
-    ship->syncMode = jet2::Model::ALWAYS;
+    ship->syncMode = jet2::Model::CHANGED;
 }
 
 bool done = false;
@@ -65,6 +65,19 @@ void server(Ptr<coro::Event> event) {
         ship->type = std::string("foobar"); // Should not get sent
         sendFrame(conn, db);
 
+        // The new ship reuses the deleted ship's slot, in the same frame
+        db->objectDel("ship1");
+        auto ship3 = db->objectIs<Ship>("ship3");
+        assert(jet2::modelIndex(ship3->id()) == jet2::modelIndex(ship->id()));
+        ship3->position = sfr::Vector(3, 3, 3);
+        sendFrame(conn, db);
+
+        // A model the client doesn't have is spawned there
+        auto ship4 = db->objectIs<Ship>("fleet/ship4");
+        ship4->type = std::string("scout");
+        ship4->position = sfr::Vector(4, 4, 4);
+        sendFrame(conn, db);
+
         while (!done) {
             event->wait();
         }
@@ -80,21 +93,33 @@ void client(Ptr<coro::Event> event) {
         auto sd = std::make_shared<coro::Socket>();
         auto db = std::make_shared<jet2::Table>();
         auto conn = std::make_shared<jet2::Connection>(sd);
+        conn->spawn = true;
         sd->connect(coro::SocketAddr("127.0.0.1", 9091));
 
         setup(db);
 
         auto ship = db->object<Ship>("ship1");
         ship->netMode = jet2::Model::INPUT;
+        auto ship3 = db->objectIs<Ship>("ship3"); // Created later on the server
+        ship3->netMode = jet2::Model::INPUT;
 
-		recvMessage(conn, db);
-        recvMessage(conn, db); 
+		recvFrame(conn, db);
+        recvFrame(conn, db); 
+        assert(ship->position() == sfr::Vector(2, 2, 2));
+        assert(ship->type() == "foo");
+
+        // Bound by path, though the server's id for it is a reused slot
+        recvFrame(conn, db);
+        assert(!db->object<Ship>("ship1"));
+        assert(ship3->position() == sfr::Vector(3, 3, 3));
+
+        recvFrame(conn, db);
+        auto ship4 = db->object<Ship>("fleet/ship4");
+        assert(ship4 && ship4->netMode() == jet2::Model::INPUT);
+        assert(ship4->type() == "scout" && ship4->position() == sfr::Vector(4, 4, 4));
 
         done = true;
         event->notifyAll();
-
-        assert(ship->position() == sfr::Vector(2, 2, 2));
-        assert(ship->type() == "foo");
         std::cout << "pass" << std::endl;
     } catch (coro::SystemError const& ex) {
         std::cout << ex.what() << std::endl;
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2013 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "jet2/Common.hpp"
+#include "jet2/jet2.hpp"
+
+template <typename T>
+using Ptr = jet2::Ptr<T>;
+
+// Measures the bytes per frame sent by the server for a scene where only a
+// few models change each frame, with and without delta compression, with a
+// per-frame byte budget, and with frame compression.  For the compressed run,
+// also reports the compression ratio and encode time per byte.
+
+int const SHIPS = 500;
+int const FRAMES = 50;
+int const STRIDE = 10; // One out of every STRIDE ships moves each frame
+size_t const BUDGET = 512; // Bytes per frame for the budgeted run
+
+class Ship : public jet2::Model {
+public:
+    jet2::Attr<std::string> type;
+    jet2::Attr<uint32_t> health;
+    CONSTRUCT(type);
+    SERIALIZED(position, rotation, health);
+};
+
+void setup(Ptr<jet2::Table> db, jet2::Model::NetMode mode) {
+    // Set up a sample scene (identical setup on both connection sides)
+    for (auto i = 0; i < SHIPS; ++i) {
+        auto ship = db->objectIs<Ship>(jet2::format("ship%d", i));
+        ship->syncMode = jet2::Model::CHANGED;
+        ship->netMode = mode;
+    }
+}
+
+void move(Ptr<jet2::Table> db, int frame) {
+    for (auto i = frame % STRIDE; i < SHIPS; i += STRIDE) {
+        auto ship = db->object<Ship>(jet2::format("ship%d", i));
+        ship->position = sfr::Vector(float(frame), float(i), 0);
+    }
+}
+
+void server(bool delta, size_t budget, bool compress, uint16_t port) {
+    try {
+        auto ls = std::make_shared<coro::Socket>();
+        ls->setsockopt(SOL_SOCKET, SO_REUSEADDR, 1);
+        ls->bind(coro::SocketAddr("127.0.0.1", port));
+        ls->listen(10);
+
+        auto sd = ls->accept();
+        auto db = std::make_shared<jet2::Table>();
+        auto conn = std::make_shared<jet2::Connection>(sd);
+        conn->delta = delta;
+        conn->budget = budget;
+        conn->compress = compress;
+
+        setup(db, jet2::Model::OUTPUT);
+        sendFrame(conn, db); // Initial state; not counted
+
+        auto start = conn->writer()->bytes();
+        auto maxFrame = uint64_t(0);
+        for (auto frame = 0; frame < FRAMES; ++frame) {
+            auto const before = conn->writer()->bytes();
+            move(db, frame);
+            sendFrame(conn, db);
+            maxFrame = std::max(maxFrame, conn->writer()->bytes()-before);
+        }
+        auto perFrame = (conn->writer()->bytes()-start)/FRAMES;
+        auto name = compress ? "compress" : budget ? "budget" : delta ? "delta" : "full";
+        std::cout << name << ": " << perFrame << " bytes/frame, max " << maxFrame << std::endl;
+        if (compress) {
+            auto const& compressor = conn->compressor;
+            auto const ratio = double(compressor.bytesOut())/double(compressor.bytesIn());
+            auto const nsPerByte = double(compressor.nanosec())/double(compressor.bytesIn());
+            std::cout << "compress: ratio " << ratio << ", " << nsPerByte << " ns/byte" << std::endl;
+        }
+        for (auto before = uint64_t(0); before != conn->writer()->bytes();) {
+            before = conn->writer()->bytes();
+            sendFrame(conn, db); // Drain models deferred by the budget
+        }
+        sd->close();
+    } catch (coro::SystemError const& ex) {
+        std::cout << ex.what() << std::endl;
+        exit(1);
+    }
+}
+
+void client(bool compress, uint16_t port) {
+    auto sd = std::make_shared<coro::Socket>();
+    auto db = std::make_shared<jet2::Table>();
+    auto conn = std::make_shared<jet2::Connection>(sd);
+    conn->compress = compress;
+    setup(db, jet2::Model::INPUT);
+    try {
+        sd->connect(coro::SocketAddr("127.0.0.1", port));
+        for (;;) {
+            recvFrame(conn, db);
+        }
+    } catch (coro::SocketCloseException const&) {
+    } catch (coro::SystemError const& ex) {
+        std::cout << ex.what() << std::endl;
+        exit(1);
+    }
+
+    auto expected = std::make_shared<jet2::Table>();
+    setup(expected, jet2::Model::INPUT);
+    for (auto frame = 0; frame < FRAMES; ++frame) {
+        move(expected, frame);
+    }
+    for (auto i = 0; i < SHIPS; ++i) {
+        auto name = jet2::format("ship%d", i);
+        assert(db->object<Ship>(name)->position() == expected->object<Ship>(name)->position());
+    }
+}
+
+int main() {
+    auto fullServer = coro::start([] { server(false, 0, false, 9092); });
+    auto fullClient = coro::start([] { client(false, 9092); });
+    auto deltaServer = coro::start([] { server(true, 0, false, 9093); });
+    auto deltaClient = coro::start([] { client(false, 9093); });
+    auto budgetServer = coro::start([] { server(true, BUDGET, false, 9095); });
+    auto budgetClient = coro::start([] { client(false, 9095); });
+    auto compressServer = coro::start([] { server(true, 0, true, 9096); });
+    auto compressClient = coro::start([] { client(true, 9096); });
+    coro::run();
+    return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "jet2/Common.hpp"
+#include "jet2/Object.hpp"
+#include "jet2/Reader.hpp"
+#include "jet2/Snapshot.hpp"
+#include "jet2/Writer.hpp"
+
+using namespace jet2;
+
+class Message : public Object {
+public:
+    Attr<uint32_t> id;
+    Attr<int32_t> delta;
+    Attr<uint8_t> flags;
+    Attr<std::string> name;
+    SERIALIZED(varint(id), varint(delta), varint(flags), name);
+};
+
+Ptr<Message> roundTrip(Ptr<Message> msg, size_t& len) {
+    auto writer = std::make_shared<MemoryWriter>();
+    auto out = Ptr<Functor>(new WriteFunctor<MemoryWriter>(writer));
+    msg->visit(out);
+    len = writer->size();
+
+    auto reader = std::make_shared<MemoryReader>();
+    reader->bufferIs(writer->data(), writer->size());
+    auto in = Ptr<Functor>(new MemoryReadFunctor(reader));
+    auto copy = std::make_shared<Message>();
+    copy->visit(in);
+    assert(!reader->error() && reader->remaining() == 0);
+    return copy;
+}
+
+int main() {
+    char buf[VARINT_MAX];
+    auto const values = { uint64_t(0), uint64_t(1), uint64_t(127), uint64_t(128), uint64_t(16383), uint64_t(16384), ~uint64_t(0) };
+    for (auto value : values) {
+        auto const len = varintEncode(value, buf);
+        assert(len == varintSize(value));
+        auto out = uint64_t(0);
+        assert(varintDecode(buf, len, out) == len && out == value);
+        assert(varintDecode(buf, len-1, out) == 0); // Truncated
+    }
+    assert(varintSize(127) == 1 && varintSize(128) == 2 && varintSize(~uint64_t(0)) == VARINT_MAX);
+
+    auto const signedValues = { int64_t(0), int64_t(-1), int64_t(1), int64_t(-64), int64_t(63), INT64_MIN, INT64_MAX };
+    for (auto value : signedValues) {
+        assert(unzigzag(zigzag(value)) == value);
+    }
+    assert(zigzag(-1) == 1 && zigzag(1) == 2 && varintSize(zigzag(-64)) == 1);
+
+    // Small values take one byte each; the string length takes one byte
+    auto msg = std::make_shared<Message>();
+    msg->id = 5;
+    msg->delta = -3;
+    msg->flags = 2;
+    msg->name = std::string("abc");
+    auto len = size_t(0);
+    auto copy = roundTrip(msg, len);
+    assert(len == 1+1+1+1+3);
+    assert(copy->id() == 5 && copy->delta() == -3 && copy->flags() == 2 && copy->name() == "abc");
+
+    msg->id = 70000;
+    msg->delta = INT32_MIN;
+    copy = roundTrip(msg, len);
+    assert(len == 3+5+1+1+3);
+    assert(copy->id() == 70000 && copy->delta() == INT32_MIN);
+
+    // A varint is one snapshot field, whatever its length, so deltas work
+    // when a value's encoded length changes
+    auto base = std::make_shared<Snapshot>();
+    msg->visit(base);
+    msg->id = 1;
+    auto next = std::make_shared<Snapshot>();
+    msg->visit(next);
+    assert(base->fields() == 5 && next->fields() == base->fields());
+    assert(!next->fieldEq(*base, 0) && next->fieldEq(*base, 1));
+
+    auto writer = std::make_shared<MemoryWriter>();
+    next->deltaOut(Ptr<Functor>(new WriteFunctor<MemoryWriter>(writer)), *base);
+    auto reader = std::make_shared<MemoryReader>();
+    reader->bufferIs(writer->data(), writer->size());
+    auto delta = std::make_shared<DeltaReadFunctor>(Ptr<Functor>(new MemoryReadFunctor(reader)));
+    copy->visit(delta);
+    assert(!reader->error() && reader->remaining() == 0);
+    assert(copy->id() == 1 && copy->delta() == INT32_MIN && copy->name() == "abc");
+    return 0;
+}
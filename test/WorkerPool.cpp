@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2013 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "jet2/Common.hpp"
+#include "jet2/Functions.hpp"
+#include "jet2/Kernel.hpp"
+#include "jet2/Model.hpp"
+#include "jet2/Snapshot.hpp"
+#include "jet2/Table.hpp"
+#include "jet2/WorkerPool.hpp"
+#include <atomic>
+#include <set>
+
+using namespace jet2;
+
+// Checks that the pool runs each task of a batch exactly once, for many
+// batches and pool sizes, and that encoding models on the pool gives the same
+// snapshots as encoding them one at a time, even if models share a nested
+// object.  Run under a thread sanitizer to check that encoding only reads.
+// Pooled snapshots must outlive the tick they were encoded in, because they're
+// sent later, and must be dropped as soon as the model changes.
+
+class Hull : public Object {
+public:
+    Attr<int32_t> armor = 0;
+    Attr<float> mass = 0.f;
+    SERIALIZED(armor, mass);
+};
+
+class Ship : public Model {
+public:
+    Ptr<Hull> hull = std::make_shared<Hull>();
+    Attr<int32_t> ammo = 0;
+    Attr<std::string> name;
+    SERIALIZED(position, hull, varint(ammo), name);
+};
+
+void batches(size_t threads) {
+    WorkerPool pool(threads);
+    auto ids = std::set<std::thread::id>();
+    std::mutex mutex;
+    for (size_t batch = 0; batch < 100; ++batch) {
+        auto const count = (batch*7) % 50;
+        auto ran = std::unique_ptr<std::atomic<int>[]>(new std::atomic<int>[count+1]);
+        for (size_t i = 0; i < count; ++i) {
+            ran[i] = 0;
+        }
+        pool.run(count, [&](size_t i) {
+            ++ran[i];
+            std::unique_lock<std::mutex> lock(mutex);
+            ids.insert(std::this_thread::get_id());
+        });
+        for (size_t i = 0; i < count; ++i) {
+            assert(ran[i] == 1);
+        }
+    }
+    assert(pool.threads() == threads);
+    assert(ids.size() <= threads+1); // The caller runs tasks too
+}
+
+void snapshots() {
+    auto db = std::make_shared<Table>();
+    auto mt = db->objectIs<ModelTable>("mt");
+    db->registryIs(mt);
+    auto hull = std::make_shared<Hull>();
+    hull->armor = -7;
+    hull->mass = 12.5f;
+
+    auto ids = std::vector<ModelId>();
+    for (auto i = 0; i < 1000; ++i) {
+        auto ship = db->objectIs<Ship>(format("ships/%d", i));
+        ship->hull = hull; // Shared by every ship
+        ship->position = sfr::Vector(float(i), 0, 0);
+        ship->ammo = i-500;
+        ship->name = format("ship%d", i);
+        ids.push_back(ship->id());
+    }
+
+    WorkerPool pool(4);
+    mt->snapshotIs(ids, pool);
+    for (auto id : ids) {
+        auto expected = std::make_shared<Snapshot>();
+        mt->model(id)->visit(expected);
+        assert(*mt->model(id)->snapshot() == *expected);
+    }
+
+    auto ship = std::static_pointer_cast<Ship>(mt->model(ids[0]));
+    auto const encoded = ship->snapshot();
+    ++tickId;
+    assert(ship->snapshot() == encoded);
+    ship->ammo = 1000;
+    assert(ship->snapshot() != encoded);
+}
+
+int main() {
+    batches(0);
+    batches(1);
+    batches(4);
+    snapshots();
+    std::cout << "pass" << std::endl;
+    return 0;
+}
@@ -5,6 +5,12 @@
 #include <jet2/Attr.hpp>
 #include <jet2/Writer.hpp>
 #include <jet2/Reader.hpp>
+#include <thread>
+#ifndef _WIN32
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 using namespace jet2;
 
@@ -17,6 +23,84 @@ struct Message {
     SERIALIZED(number, string);
 };
 
+#ifndef _WIN32
+class Pipe {
+// One end of a socket pair with a small, non-blocking send buffer, so that a
+// vectored write of a large frame is only partly accepted.
+public:
+    Pipe(int fd) : fd_(fd) {}
+    int fileno() const { return fd_; }
+    void writeAll(char const* buf, size_t len);
+    size_t blocked = 0; // Bytes that writev() left for writeAll()
+
+private:
+    int fd_;
+};
+
+void Pipe::writeAll(char const* buf, size_t len) {
+    blocked += len;
+    while (len > 0) {
+        auto written = ::send(fd_, buf, len, MSG_NOSIGNAL);
+        if (written < 0 && errno == EAGAIN) {
+            pollfd fd = { fd_, POLLOUT, 0 };
+            poll(&fd, 1, -1);
+        } else {
+            assert(written > 0);
+            buf += written;
+            len -= written;
+        }
+    }
+}
+
+void segments() {
+    // A flush interleaves buffered bytes with queued segments, and sends in
+    // order what a partial writev() left over.
+    static_assert(HasFileno<Pipe>::value, "Pipe must take the writev() path");
+    int fd[2];
+    auto const paired = socketpair(AF_UNIX, SOCK_STREAM, 0, fd);
+    assert(paired == 0);
+    auto const sndbuf = 4096;
+    setsockopt(fd[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    fcntl(fd[0], F_SETFL, fcntl(fd[0], F_GETFL) | O_NONBLOCK);
+
+    auto expected = std::vector<char>();
+    auto received = std::vector<char>();
+    auto reader = std::thread([&] {
+        char buf[4096];
+        for (ssize_t len; (len = ::read(fd[1], buf, sizeof(buf))) > 0;) {
+            received.insert(received.end(), buf, buf+len);
+        }
+    });
+
+    auto pipe = std::make_shared<Pipe>(fd[0]);
+    auto writer = std::make_shared<Writer<Pipe>>(pipe);
+    auto big = std::make_shared<std::vector<char>>(64*1024);
+    for (size_t i = 0; i < big->size(); ++i) {
+        (*big)[i] = char(i*7);
+    }
+    char head[] = "head";
+    char tail[] = "tail";
+    writer->write(head, 4);
+    writer->segmentIs(big, big->data(), big->size());
+    writer->write(tail, 4);
+    writer->segmentIs(big, big->data()+1, big->size()-1);
+    writer->flush();
+    expected.insert(expected.end(), head, head+4);
+    expected.insert(expected.end(), big->begin(), big->end());
+    expected.insert(expected.end(), tail, tail+4);
+    expected.insert(expected.end(), big->begin()+1, big->end());
+
+    ::shutdown(fd[0], SHUT_WR);
+    reader.join();
+    ::close(fd[0]);
+    ::close(fd[1]);
+    std::cout << "segments: " << expected.size()-pipe->blocked << " bytes by writev, ";
+    std::cout << pipe->blocked << " by writeAll" << std::endl;
+    assert(writer->bytes() == expected.size());
+    assert(pipe->blocked > 0 && pipe->blocked < expected.size()); // Partial
+    assert(received == expected);
+}
+#endif
 
 void readmsg(Ptr<Functor> in, std::string const expected) {
     try {
@@ -82,6 +166,9 @@ void client() {
 }
 
 int main() {
+#ifndef _WIN32
+    segments(); // Needs a POSIX socket pair
+#endif
     //coro::start(run);
     auto serverCoro = coro::start(server);
     auto clientCoro = coro::start(client);
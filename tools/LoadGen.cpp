@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2014 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <jet2/Common.hpp>
+#include <jet2/jet2.hpp>
+#include <ctime>
+
+// Headless load generator.  Starts a server and N bot clients in one process.
+// The server moves every ship each tick; each bot sends scripted input and
+// receives the replicated scene.  After the run, reports the server tick
+// period, the bytes sent per client, and the latency of updates (from when
+// the server made a state to when a bot received it).
+//
+// Usage: jet2-loadgen [clients] [ships] [seconds] [workers] [port]
+//
+// Each client uses a socket on both ends, so raise the open file limit
+// (ulimit -n) for large runs.
+
+using jet2::Ptr;
+using jet2::NetClock;
+using jet2::NetTime;
+
+class Ship : public jet2::Model {
+public:
+    jet2::Attr<std::string> type;
+    CONSTRUCT(type);
+    SERIALIZED(position, rotation);
+};
+
+class Stamp : public jet2::Model {
+public:
+    jet2::Attr<NetTime> made = NetTime(0); // When the server made this state
+    SERIALIZED(made);
+};
+
+class BotInput : public jet2::Model {
+public:
+    jet2::Attr<float> thrust = 0.f;
+    jet2::Attr<float> turn = 0.f;
+    SERIALIZED(thrust, turn);
+};
+
+class Bot {
+public:
+    Ptr<jet2::Table> db;
+    Ptr<jet2::Client> client;
+    Ptr<Stamp> stamp;
+    Ptr<BotInput> input;
+    Ptr<coro::Coroutine> watch;
+};
+
+size_t clients = 100;
+size_t ships = 200;
+double seconds = 10;
+size_t workers = 0;
+uint16_t port = jet2::SERVER_PORT;
+
+std::vector<double> tickPeriod; // Microseconds
+std::vector<double> latency; // Microseconds
+bool measuring = false;
+
+void setup(Ptr<jet2::Table> models, jet2::Model::NetMode mode) {
+    // The replicated scene; identical on the server and each bot
+    models->objectIs<Stamp>("stamp")->netMode = mode;
+    for (size_t i = 0; i < ships; ++i) {
+        models->objectIs<Ship>(jet2::format("ship%d", int(i)))->netMode = mode;
+    }
+}
+
+void simulate(Ptr<jet2::Table> models) {
+    // Move every ship once per tick, and note when the state was made
+    auto stamp = models->object<Stamp>("stamp");
+    auto last = NetClock::now();
+    for (;;) {
+        coro::sleep(jet2::timestep);
+        auto const now = NetClock::now();
+        if (measuring) {
+            tickPeriod.push_back(double(now-last));
+        }
+        last = now;
+        jet2::tickId++;
+        jet2::tickTime = now;
+        auto const t = float(jet2::tickId*jet2::timestep.sec());
+        for (size_t i = 0; i < ships; ++i) {
+            auto ship = models->object<Ship>(jet2::format("ship%d", int(i)));
+            auto const angle = t+float(i);
+            ship->position = sfr::Vector(std::cos(angle)*50.f, std::sin(angle)*50.f, float(i));
+        }
+        stamp->made = NetClock::now();
+    }
+}
+
+void watch(Ptr<Stamp> stamp) {
+    // Record the latency of each update received by a bot
+    for (;;) {
+        stamp->wait();
+        if (measuring) {
+            latency.push_back(double(NetClock::now()-stamp->made()));
+        }
+    }
+}
+
+void script(std::vector<Ptr<Bot>> const* bots) {
+    // Drive each bot's input, once per net tick
+    for (auto frame = 0;; ++frame) {
+        for (size_t i = 0; i < bots->size(); ++i) {
+            auto input = (*bots)[i]->input;
+            input->thrust = std::sin(float(frame+i)*.1f);
+            input->turn = std::cos(float(frame+i)*.1f);
+        }
+        coro::sleep(jet2::netTimestep);
+    }
+}
+
+double percentile(std::vector<double>& value, double p) {
+    if (value.empty()) {
+        return 0;
+    }
+    std::sort(value.begin(), value.end());
+    auto const index = std::min(value.size()-1, size_t(double(value.size())*p/100.));
+    return value[index];
+}
+
+double mean(std::vector<double> const& value) {
+    auto sum = 0.;
+    for (auto v : value) {
+        sum += v;
+    }
+    return value.empty() ? 0 : sum/double(value.size());
+}
+
+uint64_t bytesSent(Ptr<jet2::Server> server, size_t* connected=0) {
+    // Total bytes sent by the server to all players
+    auto bytes = uint64_t(0);
+    for (auto player : server->player) {
+        if (player) {
+            bytes += player->conn()->writer()->bytes();
+            if (connected) {
+                ++*connected;
+            }
+        }
+    }
+    return bytes;
+}
+
+void report(Ptr<jet2::Server> server, std::vector<Ptr<Bot>> const& bots, double elapsed, uint64_t bytes, std::clock_t cpu) {
+    auto connected = size_t(0);
+    bytes = bytesSent(server, &connected)-bytes;
+    auto const ticks = tickPeriod.size();
+    auto const cpuPerTick = ticks ? double(cpu)/CLOCKS_PER_SEC/double(ticks)*1e3 : 0;
+    std::cout << "clients: " << connected << "/" << bots.size() << ", ships: " << ships << ", workers: " << workers << std::endl;
+    std::cout << "tick period: mean " << mean(tickPeriod)/1e3 << " ms, p99 " << percentile(tickPeriod, 99)/1e3;
+    std::cout << " ms, max " << percentile(tickPeriod, 100)/1e3 << " ms (target " << jet2::timestep.sec()*1e3 << " ms)" << std::endl;
+    std::cout << "cpu per tick (server and bots): " << cpuPerTick << " ms" << std::endl;
+    std::cout << "sent per client: " << (connected ? double(bytes)/double(connected)/elapsed : 0) << " bytes/s" << std::endl;
+    std::cout << "update latency: p50 " << percentile(latency, 50)/1e3 << " ms, p90 " << percentile(latency, 90)/1e3;
+    std::cout << " ms, p99 " << percentile(latency, 99)/1e3 << " ms, max " << percentile(latency, 100)/1e3;
+    std::cout << " ms (" << latency.size() << " updates)" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) { clients = size_t(atoi(argv[1])); }
+    if (argc > 2) { ships = size_t(atoi(argv[2])); }
+    if (argc > 3) { seconds = atof(argv[3]); }
+    if (argc > 4) { workers = size_t(atoi(argv[4])); }
+    if (argc > 5) { port = uint16_t(atoi(argv[5])); }
+
+    jet2::init(jet2::HEADLESS);
+    auto db = std::make_shared<jet2::Table>();
+    auto models = db->objectIs<jet2::Table>("models");
+    setup(models, jet2::Model::OUTPUT);
+    db->objectIs<BotInput>("input/bot")->netMode = jet2::Model::INPUT;
+    auto server = jet2::server(db, clients, workers, port);
+    auto sim = coro::start([=]{ simulate(models); });
+
+    auto bots = std::vector<Ptr<Bot>>();
+    auto run = coro::start([&]{
+        for (size_t i = 0; i < clients; ++i) {
+            auto bot = std::make_shared<Bot>();
+            bot->db = std::make_shared<jet2::Table>();
+            auto remotes = bot->db->objectIs<jet2::Table>("remotes");
+            setup(remotes, jet2::Model::INPUT);
+            bot->stamp = remotes->object<Stamp>("stamp");
+            bot->input = bot->db->objectIs<BotInput>("input/bot");
+            bot->input->netMode = jet2::Model::OUTPUT;
+            bot->client = jet2::client(bot->db, jet2::ClientId(i), false, false, "127.0.0.1", port);
+            bot->watch = coro::start([=]{ watch(bot->stamp); });
+            bots.push_back(bot);
+        }
+        auto input = coro::start([&]{ script(&bots); });
+        coro::sleep(coro::Time::sec(1)); // Let the initial state settle
+
+        measuring = true;
+        auto const start = NetClock::now();
+        auto const cpu = std::clock();
+        auto const bytes = bytesSent(server);
+        coro::sleep(coro::Time::sec(seconds));
+        measuring = false;
+        report(server, bots, double(NetClock::now()-start)/1e6, bytes, std::clock()-cpu);
+        ::exit(0);
+    });
+    coro::run();
+    return 0;
+}